@@ -0,0 +1,50 @@
+#version 430 core
+#extension GL_ARB_shader_draw_parameters : require
+// TriangleVertex.glsl for DrawBatcher's multi draws, position and scale come per draw
+
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aColor;
+
+// Per-instance attributes
+layout (location = 2) in vec2 aOffset;
+layout (location = 3) in vec3 aTint;
+
+out vec3 vColor;
+out vec3 vTint;
+
+// BatchDrawData, one per draw of the multi draw
+struct DrawData
+{
+	vec4 transform;	// position xyz, scale
+	uint instanced;
+};
+
+layout (std430, binding = 0) readonly buffer Draws
+{
+	DrawData draws[];
+};
+
+// GPU_ANIM computes the tint here from uTime instead of taking aTint
+#ifdef GPU_ANIM
+uniform float uTime;
+
+#include "colorconv.glsl"
+#endif
+
+void main()
+{
+	DrawData draw = draws[gl_DrawIDARB];
+
+	// A plain draw has one instance, without offset and with a neutral tint
+	bool instanced = draw.instanced != 0u;
+	vec2 offset = instanced ? aOffset : vec2(0.0);
+
+	gl_Position = vec4(aPos * draw.transform.w + vec3(offset, 0.0) + draw.transform.xyz, 1.0);
+	vColor = aColor;
+
+#ifdef GPU_ANIM
+	vTint = waveTint(uint(gl_InstanceID), uTime);
+#else
+	vTint = instanced ? aTint : vec3(1.0);
+#endif
+}
@@ -0,0 +1,151 @@
+#version 430 core
+// Culls the triangle instances and packs the survivors in their original order, in three
+// passes built from this file with one of CULL_PASS_COUNT, CULL_PASS_SCAN or CULL_PASS_WRITE.
+
+#define GROUP_SIZE 256
+// A TriangleInstance, offset.xy then tint.rgb. Read as floats, a struct would be padded to 32 bytes.
+#define INSTANCE_FLOATS 5
+
+layout (local_size_x = GROUP_SIZE) in;
+
+layout (std430, binding = 0) readonly buffer InputInstances
+{
+	float inputData[];
+};
+
+layout (std430, binding = 1) writeonly buffer OutputInstances
+{
+	float outputData[];
+};
+
+// Number of survivors, copied into the instance count of the draw
+layout (std430, binding = 2) writeonly buffer Survivors
+{
+	uint survivorCount;
+};
+
+// Survivors per group, the scan turns them into the first output index of each group
+layout (std430, binding = 3) buffer GroupCounts
+{
+	uint groupCounts[];
+};
+
+uniform uint uCount;
+uniform vec2 uPos;
+uniform float uScale;
+// Triangles smaller than this scale cover less than the minimum size on screen
+uniform float uMinScale;
+// Replace the tints with the color animation, instances lose their gl_InstanceID here
+uniform bool uAnimate;
+uniform float uTime;
+
+#include "colorconv.glsl"
+
+bool isVisible(uint index)
+{
+	if (index >= uCount || uScale < uMinScale)
+		return false;
+
+	// The triangle spans half its scale around its offset on each axis
+	vec2 center = vec2(inputData[index * INSTANCE_FLOATS], inputData[index * INSTANCE_FLOATS + 1]) + uPos;
+	float extent = 0.5 * uScale;
+	return all(lessThanEqual(abs(center), vec2(1.0 + extent)));
+}
+
+shared uint localScan[GROUP_SIZE];
+
+#ifdef CULL_PASS_COUNT
+void main()
+{
+	bool visible = isVisible(gl_GlobalInvocationID.x);
+
+	localScan[gl_LocalInvocationID.x] = visible ? 1u : 0u;
+	barrier();
+
+	// Tree sum, the first invocation ends up with the group's total
+	for (uint stride = GROUP_SIZE / 2; stride > 0; stride >>= 1)
+	{
+		if (gl_LocalInvocationID.x < stride)
+			localScan[gl_LocalInvocationID.x] += localScan[gl_LocalInvocationID.x + stride];
+		barrier();
+	}
+
+	if (gl_LocalInvocationID.x == 0)
+		groupCounts[gl_WorkGroupID.x] = localScan[0];
+}
+#endif
+
+#ifdef CULL_PASS_SCAN
+// One group scans all the counts, every invocation a consecutive run of them
+void main()
+{
+	uint groupCount = (uCount + GROUP_SIZE - 1) / GROUP_SIZE;
+	uint run = (groupCount + GROUP_SIZE - 1) / GROUP_SIZE;
+	uint first = gl_LocalInvocationID.x * run;
+	uint last = min(first + run, groupCount);
+
+	uint sum = 0;
+	for (uint i = first; i < last; i++)
+		sum += groupCounts[i];
+
+	localScan[gl_LocalInvocationID.x] = sum;
+	barrier();
+
+	// Inclusive scan of the run sums
+	for (uint stride = 1; stride < GROUP_SIZE; stride <<= 1)
+	{
+		uint add = gl_LocalInvocationID.x >= stride ? localScan[gl_LocalInvocationID.x - stride] : 0u;
+		barrier();
+		localScan[gl_LocalInvocationID.x] += add;
+		barrier();
+	}
+
+	uint offset = localScan[gl_LocalInvocationID.x] - sum;
+	for (uint i = first; i < last; i++)
+	{
+		uint count = groupCounts[i];
+		groupCounts[i] = offset;
+		offset += count;
+	}
+
+	if (gl_LocalInvocationID.x == GROUP_SIZE - 1)
+		survivorCount = localScan[GROUP_SIZE - 1];
+}
+#endif
+
+#ifdef CULL_PASS_WRITE
+void main()
+{
+	uint index = gl_GlobalInvocationID.x;
+	bool visible = isVisible(index);
+
+	localScan[gl_LocalInvocationID.x] = visible ? 1u : 0u;
+	barrier();
+
+	// Inclusive scan, survivors before this one in the group
+	for (uint stride = 1; stride < GROUP_SIZE; stride <<= 1)
+	{
+		uint add = gl_LocalInvocationID.x >= stride ? localScan[gl_LocalInvocationID.x - stride] : 0u;
+		barrier();
+		localScan[gl_LocalInvocationID.x] += add;
+		barrier();
+	}
+
+	if (!visible)
+		return;
+
+	uint target = (groupCounts[gl_WorkGroupID.x] + localScan[gl_LocalInvocationID.x] - 1) * INSTANCE_FLOATS;
+	uint source = index * INSTANCE_FLOATS;
+
+	outputData[target] = inputData[source];
+	outputData[target + 1] = inputData[source + 1];
+
+	vec3 tint = vec3(inputData[source + 2], inputData[source + 3], inputData[source + 4]);
+	if (uAnimate)
+		tint = waveTint(index, uTime);
+
+	outputData[target + 2] = tint.r;
+	outputData[target + 3] = tint.g;
+	outputData[target + 4] = tint.b;
+}
+#endif
@@ -1,5 +1,6 @@
 #version 330 core
 in vec3 vColor;
+in vec3 vTint;
 
 out vec4 fragColor;
 
@@ -7,5 +8,5 @@ uniform vec3 uColor;
 
 void main()
 {
-	fragColor = vec4(vColor + uColor, 1.0);
+	fragColor = vec4(vColor + uColor * vTint, 1.0);
 }
\ No newline at end of file
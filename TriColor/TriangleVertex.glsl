@@ -2,12 +2,31 @@
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aColor;
 
+// Per-instance attributes
+layout (location = 2) in vec2 aOffset;
+layout (location = 3) in vec3 aTint;
+
 out vec3 vColor;
+out vec3 vTint;
 
 uniform vec3 uPos;
+uniform float uScale;
+
+// GPU_ANIM computes the tint here from uTime instead of taking aTint
+#ifdef GPU_ANIM
+uniform float uTime;
+
+#include "colorconv.glsl"
+#endif
 
 void main()
 {
-	gl_Position = vec4(aPos + uPos, 1.0);
+	gl_Position = vec4(aPos * uScale + vec3(aOffset, 0.0) + uPos, 1.0);
 	vColor = aColor;
+
+#ifdef GPU_ANIM
+	vTint = waveTint(uint(gl_InstanceID), uTime);
+#else
+	vTint = aTint;
+#endif
 }
\ No newline at end of file
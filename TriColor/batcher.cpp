@@ -0,0 +1,366 @@
+#include "batcher.h"
+#include "glextensions.h"
+#include "scene.h"
+
+#include <algorithm>
+#include <cstring>
+
+DrawBatcher::DrawBatcher() :
+	// Neither target is bound for drawing, any target GL 3.3 knows will do for creating them
+	commands(GL_COPY_WRITE_BUFFER, BATCH_MAX_DRAWS * sizeof(DrawElementsIndirectCommand)),
+	drawData(GL_COPY_WRITE_BUFFER, BATCH_MAX_DRAWS * sizeof(BatchDrawData))
+{
+	multiDraw = GLExt.multiDrawIndirect;
+	vertexCapacity = BATCH_INITIAL_VERTICES;
+	indexCapacity = BATCH_INITIAL_INDICES;
+	vertexCount = 0;
+	indexCount = 0;
+	instanceBuffer = 0;
+	instanceOffset = 0;
+	stats = {};
+	stats.multiDraw = multiDraw;
+
+	// Draw data ranges are bound as storage buffers, their offsets have to be aligned
+	int alignment = 1;
+	if (multiDraw)
+		glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+	drawDataAlignment = (size_t)std::max(alignment, 1);
+
+	queue.reserve(BATCH_MAX_DRAWS);
+	sorted.reserve(BATCH_MAX_DRAWS);
+
+	glGenBuffers(1, &vertexBuffer);
+	glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+	glBufferData(GL_ARRAY_BUFFER, vertexCapacity * sizeof(MeshVertex), NULL, GL_STATIC_DRAW);
+
+	glGenBuffers(1, &indexBuffer);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, indexBuffer);
+	glBufferData(GL_COPY_WRITE_BUFFER, indexCapacity * sizeof(unsigned int), NULL, GL_STATIC_DRAW);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+	glGenVertexArrays(1, &ID);
+	glBindVertexArray(ID);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(MeshVertex), (GLvoid*)offsetof(MeshVertex, position));
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(MeshVertex), (GLvoid*)offsetof(MeshVertex, color));
+	glEnableVertexAttribArray(1);
+
+	// Instance data, attribute 2 and 3 advance once per instance
+	glVertexAttribDivisor(2, 1);
+	glVertexAttribDivisor(3, 1);
+	glBindVertexArray(0);
+}
+
+DrawBatcher::~DrawBatcher()
+{
+	release();
+}
+
+static DrawElementsIndirectCommand makeCommand(const BatchMeshRange& range, const BatchDraw& draw, bool multiDraw)
+{
+	DrawElementsIndirectCommand command;
+	command.count = draw.indexCount != 0 ? std::min(draw.indexCount, range.indexCount) : range.indexCount;
+	command.instanceCount = draw.instanceCount != 0 ? draw.instanceCount : 1;
+	command.firstIndex = range.firstIndex;
+	command.baseVertex = (int)range.baseVertex;
+	// Without multi draw the attribute pointers are moved instead, base instances need GL 4.2
+	command.baseInstance = multiDraw ? draw.baseInstance : 0;
+	return command;
+}
+
+/*
+Make "buffer" hold at least "needed" elements, doubling it and copying the "used" ones over.
+The element array binding lives in the VAO, it's redone for the index buffer.
+*/
+void DrawBatcher::grow(GLenum target, unsigned int& buffer, size_t& capacity, size_t used, size_t needed, size_t elementSize)
+{
+	if (needed <= capacity)
+		return;
+
+	size_t newCapacity = std::max(capacity * 2, needed);
+
+	unsigned int newBuffer;
+	glGenBuffers(1, &newBuffer);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, newBuffer);
+	glBufferData(GL_COPY_WRITE_BUFFER, newCapacity * elementSize, NULL, GL_STATIC_DRAW);
+
+	if (used > 0)
+	{
+		glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, used * elementSize);
+		glBindBuffer(GL_COPY_READ_BUFFER, 0);
+	}
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+	glDeleteBuffers(1, &buffer);
+	buffer = newBuffer;
+	capacity = newCapacity;
+
+	glBindVertexArray(ID);
+	if (target == GL_ELEMENT_ARRAY_BUFFER)
+	{
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffer);
+	}
+	else
+	{
+		glBindBuffer(GL_ARRAY_BUFFER, buffer);
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(MeshVertex), (GLvoid*)offsetof(MeshVertex, position));
+		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(MeshVertex), (GLvoid*)offsetof(MeshVertex, color));
+	}
+	glBindVertexArray(0);
+}
+
+unsigned int DrawBatcher::addMesh(size_t vertices, size_t indices)
+{
+	grow(GL_ARRAY_BUFFER, vertexBuffer, vertexCapacity, vertexCount, vertexCount + vertices, sizeof(MeshVertex));
+	grow(GL_ELEMENT_ARRAY_BUFFER, indexBuffer, indexCapacity, indexCount, indexCount + indices, sizeof(unsigned int));
+
+	BatchMeshRange range;
+	range.baseVertex = (unsigned int)vertexCount;
+	range.vertexCount = (unsigned int)vertices;
+	range.firstIndex = (unsigned int)indexCount;
+	range.indexCount = (unsigned int)indices;
+	meshes.push_back(range);
+
+	vertexCount += vertices;
+	indexCount += indices;
+	stats.vertexBytes = vertexCount * sizeof(MeshVertex);
+	stats.indexBytes = indexCount * sizeof(unsigned int);
+
+	return (unsigned int)meshes.size();
+}
+
+void DrawBatcher::uploadVertices(unsigned int mesh, size_t first, const MeshVertex* vertices, size_t count)
+{
+	const BatchMeshRange& range = getMesh(mesh);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, vertexBuffer);
+	glBufferSubData(GL_COPY_WRITE_BUFFER, (range.baseVertex + first) * sizeof(MeshVertex), count * sizeof(MeshVertex), vertices);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+void DrawBatcher::uploadIndices(unsigned int mesh, size_t first, const unsigned int* indices, size_t count)
+{
+	const BatchMeshRange& range = getMesh(mesh);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, indexBuffer);
+	glBufferSubData(GL_COPY_WRITE_BUFFER, (range.firstIndex + first) * sizeof(unsigned int), count * sizeof(unsigned int), indices);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+void DrawBatcher::setInstanceBuffer(unsigned int buffer, GLintptr offset)
+{
+	instanceBuffer = buffer;
+	instanceOffset = offset;
+}
+
+void DrawBatcher::setInstanceAttributes(GLintptr offset)
+{
+	glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(TriangleInstance), (GLvoid*)(offset + offsetof(TriangleInstance, offset)));
+	glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(TriangleInstance), (GLvoid*)(offset + offsetof(TriangleInstance, tint)));
+}
+
+void DrawBatcher::add(Shader& material, unsigned int mesh, const BatchDraw& draw)
+{
+	if (queue.size() >= BATCH_MAX_DRAWS)
+		return;
+
+	queue.push_back({ &material, mesh, draw });
+}
+
+void DrawBatcher::flush()
+{
+	stats.draws = (unsigned int)queue.size();
+	stats.calls = 0;
+	if (queue.empty())
+		return;
+
+	// Group by material, stable so draws keep their order inside a group
+	materials.clear();
+	for (const QueuedDraw& queued : queue)
+	{
+		if (std::find(materials.begin(), materials.end(), queued.material) == materials.end())
+			materials.push_back(queued.material);
+	}
+
+	sorted.clear();
+	for (Shader* material : materials)
+	{
+		for (const QueuedDraw& queued : queue)
+		{
+			if (queued.material == material)
+				sorted.push_back(queued);
+		}
+	}
+	queue.clear();
+
+	// Commands for every draw. The multi draw reads all of them, without it only the draws
+	// whose instance count is on the GPU do.
+	commands.beginFrame();
+	GLintptr commandOffset = 0;
+	DrawElementsIndirectCommand* command = (DrawElementsIndirectCommand*)commands.allocate(
+		sorted.size() * sizeof(DrawElementsIndirectCommand), sizeof(unsigned int), commandOffset);
+
+	GLintptr dataOffset = 0;
+	BatchDrawData* data = NULL;
+	if (multiDraw)
+	{
+		drawData.beginFrame();
+		data = (BatchDrawData*)drawData.allocate(sorted.size() * sizeof(BatchDrawData), drawDataAlignment, dataOffset);
+	}
+
+	bool written = command != NULL && (!multiDraw || data != NULL);
+	if (written)
+	{
+		for (size_t i = 0; i < sorted.size(); i++)
+		{
+			const BatchDraw& draw = sorted[i].draw;
+			command[i] = makeCommand(getMesh(sorted[i].mesh), draw, multiDraw);
+
+			if (multiDraw)
+			{
+				memcpy(data[i].transform, draw.position, sizeof(draw.position));
+				data[i].transform[3] = draw.scale;
+				data[i].instanced = draw.instanceCount != 0 || draw.countBuffer != 0;
+				data[i].padding[0] = data[i].padding[1] = data[i].padding[2] = 0;
+			}
+		}
+	}
+
+	commands.flush();
+	if (multiDraw)
+		drawData.flush();
+
+	if (!written)
+	{
+		commands.endFrame();
+		if (multiDraw)
+			drawData.endFrame();
+		return;
+	}
+
+	// Instance counts that only the GPU knows go straight into the commands
+	for (size_t i = 0; i < sorted.size(); i++)
+	{
+		const BatchDraw& draw = sorted[i].draw;
+		if (draw.countBuffer == 0)
+			continue;
+
+		glBindBuffer(GL_COPY_READ_BUFFER, draw.countBuffer);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, commands.ID);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, draw.countOffset,
+			commandOffset + i * sizeof(DrawElementsIndirectCommand) + offsetof(DrawElementsIndirectCommand, instanceCount),
+			sizeof(unsigned int));
+	}
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+	glBindVertexArray(ID);
+	if (instanceBuffer != 0)
+	{
+		setInstanceAttributes(instanceOffset);
+		glEnableVertexAttribArray(2);
+		glEnableVertexAttribArray(3);
+	}
+	else
+	{
+		glDisableVertexAttribArray(2);
+		glDisableVertexAttribArray(3);
+		glVertexAttrib2f(2, 0.0f, 0.0f);
+		glVertexAttrib3f(3, 1.0f, 1.0f, 1.0f);
+	}
+	if (GLExt.drawIndirect)
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commands.ID);
+
+	size_t first = 0;
+	while (first < sorted.size())
+	{
+		Shader* material = sorted[first].material;
+		size_t last = first;
+		while (last < sorted.size() && sorted[last].material == material)
+			last++;
+
+		material->use();
+
+		if (multiDraw)
+		{
+			// One call for the whole material, each draw finds its data at gl_DrawID
+			glBindBufferRange(GL_SHADER_STORAGE_BUFFER, BATCH_DRAW_DATA_BINDING, drawData.ID,
+				dataOffset + first * sizeof(BatchDrawData), (last - first) * sizeof(BatchDrawData));
+			GLExt.MultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT,
+				(const void*)(commandOffset + first * sizeof(DrawElementsIndirectCommand)), (GLsizei)(last - first), 0);
+			stats.calls++;
+		}
+		else
+		{
+			for (size_t i = first; i < last; i++)
+			{
+				const BatchDraw& draw = sorted[i].draw;
+				material->set("uPos", draw.position[0], draw.position[1], draw.position[2]);
+				material->set("uScale", draw.scale);
+
+				// Plain draws get no offset and a neutral tint
+				bool instanced = draw.instanceCount != 0 || draw.countBuffer != 0;
+				if (instanced && instanceBuffer != 0)
+				{
+					setInstanceAttributes(instanceOffset + draw.baseInstance * sizeof(TriangleInstance));
+					glEnableVertexAttribArray(2);
+					glEnableVertexAttribArray(3);
+				}
+				else
+				{
+					glDisableVertexAttribArray(2);
+					glDisableVertexAttribArray(3);
+					glVertexAttrib2f(2, 0.0f, 0.0f);
+					glVertexAttrib3f(3, 1.0f, 1.0f, 1.0f);
+				}
+
+				if (draw.countBuffer != 0 && GLExt.drawIndirect)
+				{
+					GLExt.DrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT,
+						(const void*)(commandOffset + i * sizeof(DrawElementsIndirectCommand)));
+				}
+				else
+				{
+					// The mapped commands may be gone after the flush, these are made again
+					DrawElementsIndirectCommand direct = makeCommand(getMesh(sorted[i].mesh), draw, false);
+					glDrawElementsInstancedBaseVertex(GL_TRIANGLES, direct.count, GL_UNSIGNED_INT,
+						(const void*)(direct.firstIndex * sizeof(unsigned int)), direct.instanceCount, direct.baseVertex);
+				}
+				stats.calls++;
+			}
+		}
+
+		first = last;
+	}
+
+	if (multiDraw)
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, BATCH_DRAW_DATA_BINDING, 0);
+	if (GLExt.drawIndirect)
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	glBindVertexArray(0);
+
+	commands.endFrame();
+	if (multiDraw)
+		drawData.endFrame();
+}
+
+void DrawBatcher::release()
+{
+	commands.release();
+	drawData.release();
+
+	if (ID != 0)
+		glDeleteVertexArrays(1, &ID);
+	if (vertexBuffer != 0)
+		glDeleteBuffers(1, &vertexBuffer);
+	if (indexBuffer != 0)
+		glDeleteBuffers(1, &indexBuffer);
+
+	ID = 0;
+	vertexBuffer = 0;
+	indexBuffer = 0;
+	meshes.clear();
+	vertexCount = 0;
+	indexCount = 0;
+}
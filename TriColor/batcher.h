@@ -0,0 +1,175 @@
+#pragma once
+
+#ifndef BATCHER_H
+#define BATCHER_H
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <vector>
+
+#include "shader.h"
+#include "streambuffer.h"
+
+// Most draws between two flushes
+#define BATCH_MAX_DRAWS 1024
+// Starting size of the shared vertex and index arenas, in vertices and indices
+#define BATCH_INITIAL_VERTICES 65536
+#define BATCH_INITIAL_INDICES 65536
+// Storage buffer binding of the per-draw data in BatchVertex.glsl
+#define BATCH_DRAW_DATA_BINDING 0
+
+/*
+The vertex layout every batched mesh shares, attribute 0 and 1.
+*/
+struct MeshVertex
+{
+	float position[3];
+	float color[3];
+};
+
+/*
+Where a mesh lives in the arenas. Its indices count from its first vertex.
+*/
+struct BatchMeshRange
+{
+	unsigned int baseVertex;
+	unsigned int vertexCount;
+	unsigned int firstIndex;
+	unsigned int indexCount;
+};
+
+/*
+One draw of a mesh.
+*/
+struct BatchDraw
+{
+	float position[3];
+	float scale;
+	// Instances from "baseInstance" on in the instance buffer, 0 for one plain instance
+	// without offset or tint
+	unsigned int instanceCount;
+	unsigned int baseInstance;
+	// Indices from the start of the mesh, 0 for all of them
+	unsigned int indexCount;
+	// If not 0, the instance count is copied from this buffer at "countOffset" on the GPU,
+	// instanceCount is only used without indirect draws
+	unsigned int countBuffer;
+	GLintptr countOffset;
+};
+
+/*
+Per-draw data as BatchVertex.glsl reads it, std430.
+*/
+struct BatchDrawData
+{
+	float transform[4];	// position xyz, scale
+	unsigned int instanced;
+	unsigned int padding[3];
+};
+
+/*
+Mirrors glDrawElementsIndirect's parameter block.
+*/
+struct DrawElementsIndirectCommand
+{
+	unsigned int count;
+	unsigned int instanceCount;
+	unsigned int firstIndex;
+	int baseVertex;
+	unsigned int baseInstance;
+};
+
+struct BatchStats
+{
+	// Draws and GL draw calls in the last flush
+	unsigned int draws;
+	unsigned int calls;
+	// Bytes in use in the arenas
+	size_t vertexBytes;
+	size_t indexBytes;
+	bool multiDraw;
+};
+
+/*
+Draws many meshes with few draw calls. Every mesh is packed into one shared vertex buffer and
+one shared index buffer (the arenas), so a single VAO serves them all.
+
+Draws are collected with add() during the frame and issued by flush(), grouped by material.
+With multi draw indirect (GL 4.3 and gl_DrawID) each material is one glMultiDrawElementsIndirect:
+the commands and the per-draw data come from StreamBuffers, the vertex shader finds its draw's
+position and scale in a storage buffer at gl_DrawID. Draw the materials with BatchVertex.glsl.
+
+Without it every draw is its own glDrawElementsInstancedBaseVertex with uPos and uScale set as
+uniforms, with the shaders written against TriangleVertex.glsl.
+
+Draws of the same material keep their order, materials go in the order they were first used.
+The arenas only grow, meshes stay until release().
+*/
+class DrawBatcher
+{
+public:
+	// Vertex array reading the arenas and the instance buffer
+	unsigned int ID;
+
+	DrawBatcher();
+	~DrawBatcher();
+
+	DrawBatcher(const DrawBatcher&) = delete;
+	DrawBatcher& operator=(const DrawBatcher&) = delete;
+
+	// Make room for a mesh, filled in with uploadVertices() and uploadIndices(). Returns its handle, never 0.
+	unsigned int addMesh(size_t vertexCount, size_t indexCount);
+	// Write "count" vertices or indices of "mesh" starting at "first"
+	void uploadVertices(unsigned int mesh, size_t first, const MeshVertex* vertices, size_t count);
+	void uploadIndices(unsigned int mesh, size_t first, const unsigned int* indices, size_t count);
+	const BatchMeshRange& getMesh(unsigned int mesh) const { return meshes[mesh - 1]; }
+
+	// Instances of this frame, TriangleInstance records from "offset" in "buffer" on
+	void setInstanceBuffer(unsigned int buffer, GLintptr offset);
+
+	void add(Shader& material, unsigned int mesh, const BatchDraw& draw);
+	// Issue the draws added since the last flush
+	void flush();
+
+	bool isMultiDraw() const { return multiDraw; }
+	const BatchStats& getStats() const { return stats; }
+
+	// Delete the GL objects. Done by the destructor too, call it first if the context goes away earlier.
+	void release();
+
+private:
+	struct QueuedDraw
+	{
+		Shader* material;
+		unsigned int mesh;
+		BatchDraw draw;
+	};
+
+	bool multiDraw;
+	unsigned int vertexBuffer;
+	unsigned int indexBuffer;
+	size_t vertexCapacity;
+	size_t indexCapacity;
+	size_t vertexCount;
+	size_t indexCount;
+	std::vector<BatchMeshRange> meshes;
+
+	unsigned int instanceBuffer;
+	GLintptr instanceOffset;
+
+	StreamBuffer commands;
+	StreamBuffer drawData;
+	size_t drawDataAlignment;
+
+	// Kept between frames so nothing is allocated per frame
+	std::vector<QueuedDraw> queue;
+	std::vector<QueuedDraw> sorted;
+	std::vector<Shader*> materials;
+
+	BatchStats stats;
+
+	void grow(GLenum target, unsigned int& buffer, size_t& capacity, size_t used, size_t needed, size_t elementSize);
+	void setInstanceAttributes(GLintptr offset);
+};
+
+#endif // !BATCHER_H
@@ -0,0 +1,302 @@
+#include "colorconv.h"
+
+#include <cmath>
+#include <cstdio>
+#include <chrono>
+#include <vector>
+
+#include "imgui.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define COLORCONV_HAS_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+// MSVC emits AVX intrinsics without /arch:AVX2, only the caller has to check the CPU
+#define COLORCONV_TARGET_AVX2
+#else
+#define COLORCONV_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+// SSE2 is the baseline on x64, on 32-bit x86 only when the compiler targets it
+#if defined(_M_X64) || defined(__x86_64__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define COLORCONV_HAS_SSE2
+#endif
+
+static const char* isaNames[COLORCONV_ISA_COUNT] = {
+	"Scalar",
+	"SSE2",
+	"AVX2"
+};
+
+/*
+Branchless form of the sector switch in ImGui::ColorConvertHSVtoRGB. For channel offset n
+(5 red, 3 green, 1 blue):
+
+	k = (n + h * 6) mod 6
+	channel = v - v * s * clamp(min(k, 4 - k), 0, 1)
+
+Every path below evaluates exactly this, in the same order, so results match across ISAs.
+*/
+
+static void hsv2rgbScalar(const float* h, const float* s, const float* v, float* r, float* g, float* b, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		float hue = h[i] - floorf(h[i]);
+		float h6 = hue * 6.0f;
+		float vs = v[i] * s[i];
+
+		float k[3] = { h6 + 5.0f, h6 + 3.0f, h6 + 1.0f };
+		float out[3];
+		for (int c = 0; c < 3; c++)
+		{
+			if (k[c] >= 6.0f)
+				k[c] -= 6.0f;
+
+			float amount = fminf(k[c], 4.0f - k[c]);
+			amount = fminf(fmaxf(amount, 0.0f), 1.0f);
+			out[c] = v[i] - vs * amount;
+		}
+
+		r[i] = out[0];
+		g[i] = out[1];
+		b[i] = out[2];
+	}
+}
+
+#ifdef COLORCONV_HAS_SSE2
+static inline __m128 channelSse2(__m128 h6, __m128 offset, __m128 v, __m128 vs)
+{
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 four = _mm_set1_ps(4.0f);
+	const __m128 six = _mm_set1_ps(6.0f);
+
+	__m128 k = _mm_add_ps(h6, offset);
+	k = _mm_sub_ps(k, _mm_and_ps(_mm_cmpge_ps(k, six), six));
+
+	__m128 amount = _mm_min_ps(k, _mm_sub_ps(four, k));
+	amount = _mm_min_ps(_mm_max_ps(amount, zero), one);
+	return _mm_sub_ps(v, _mm_mul_ps(vs, amount));
+}
+
+static void hsv2rgbSse2(const float* h, const float* s, const float* v, float* r, float* g, float* b, size_t count)
+{
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 six = _mm_set1_ps(6.0f);
+
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 hue = _mm_loadu_ps(h + i);
+		__m128 sat = _mm_loadu_ps(s + i);
+		__m128 val = _mm_loadu_ps(v + i);
+
+		// SSE2 has no floor, truncate and step down where that rounded up
+		__m128 whole = _mm_cvtepi32_ps(_mm_cvttps_epi32(hue));
+		whole = _mm_sub_ps(whole, _mm_and_ps(_mm_cmpgt_ps(whole, hue), one));
+		hue = _mm_sub_ps(hue, whole);
+
+		__m128 h6 = _mm_mul_ps(hue, six);
+		__m128 vs = _mm_mul_ps(val, sat);
+
+		_mm_storeu_ps(r + i, channelSse2(h6, _mm_set1_ps(5.0f), val, vs));
+		_mm_storeu_ps(g + i, channelSse2(h6, _mm_set1_ps(3.0f), val, vs));
+		_mm_storeu_ps(b + i, channelSse2(h6, one, val, vs));
+	}
+
+	hsv2rgbScalar(h + i, s + i, v + i, r + i, g + i, b + i, count - i);
+}
+#endif
+
+#ifdef COLORCONV_HAS_X86
+COLORCONV_TARGET_AVX2
+static inline __m256 channelAvx2(__m256 h6, __m256 offset, __m256 v, __m256 vs)
+{
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 one = _mm256_set1_ps(1.0f);
+	const __m256 four = _mm256_set1_ps(4.0f);
+	const __m256 six = _mm256_set1_ps(6.0f);
+
+	__m256 k = _mm256_add_ps(h6, offset);
+	k = _mm256_sub_ps(k, _mm256_and_ps(_mm256_cmp_ps(k, six, _CMP_GE_OQ), six));
+
+	__m256 amount = _mm256_min_ps(k, _mm256_sub_ps(four, k));
+	amount = _mm256_min_ps(_mm256_max_ps(amount, zero), one);
+	return _mm256_sub_ps(v, _mm256_mul_ps(vs, amount));
+}
+
+COLORCONV_TARGET_AVX2
+static void hsv2rgbAvx2(const float* h, const float* s, const float* v, float* r, float* g, float* b, size_t count)
+{
+	const __m256 six = _mm256_set1_ps(6.0f);
+
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256 hue = _mm256_loadu_ps(h + i);
+		__m256 sat = _mm256_loadu_ps(s + i);
+		__m256 val = _mm256_loadu_ps(v + i);
+
+		hue = _mm256_sub_ps(hue, _mm256_floor_ps(hue));
+
+		__m256 h6 = _mm256_mul_ps(hue, six);
+		__m256 vs = _mm256_mul_ps(val, sat);
+
+		_mm256_storeu_ps(r + i, channelAvx2(h6, _mm256_set1_ps(5.0f), val, vs));
+		_mm256_storeu_ps(g + i, channelAvx2(h6, _mm256_set1_ps(3.0f), val, vs));
+		_mm256_storeu_ps(b + i, channelAvx2(h6, _mm256_set1_ps(1.0f), val, vs));
+	}
+
+	hsv2rgbScalar(h + i, s + i, v + i, r + i, g + i, b + i, count - i);
+}
+
+static bool cpuHasAvx2()
+{
+#ifdef _MSC_VER
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7)
+		return false;
+
+	// The CPU needs AVX and the OS has to save the YMM registers (OSXSAVE, XCR0 bits 1 and 2)
+	__cpuid(info, 1);
+	bool avx = (info[2] & (1 << 28)) != 0;
+	bool osxsave = (info[2] & (1 << 27)) != 0;
+	if (!avx || !osxsave || (_xgetbv(0) & 6) != 6)
+		return false;
+
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#else
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2");
+#endif
+}
+#endif
+
+bool isColorConvIsaSupported(ColorConvIsa isa)
+{
+	switch (isa)
+	{
+	case COLORCONV_SCALAR:
+		return true;
+#ifdef COLORCONV_HAS_SSE2
+	case COLORCONV_SSE2:
+		return true;
+#endif
+#ifdef COLORCONV_HAS_X86
+	case COLORCONV_AVX2:
+	{
+		static const bool avx2 = cpuHasAvx2();
+		return avx2;
+	}
+#endif
+	default:
+		return false;
+	}
+}
+
+const char* getColorConvIsaName(ColorConvIsa isa)
+{
+	return isaNames[isa];
+}
+
+void hsv2rgb(ColorConvIsa isa, const float* h, const float* s, const float* v, float* r, float* g, float* b, size_t count)
+{
+	switch (isa)
+	{
+#ifdef COLORCONV_HAS_X86
+	case COLORCONV_AVX2:
+		hsv2rgbAvx2(h, s, v, r, g, b, count);
+		break;
+#endif
+#ifdef COLORCONV_HAS_SSE2
+	case COLORCONV_SSE2:
+		hsv2rgbSse2(h, s, v, r, g, b, count);
+		break;
+#endif
+	default:
+		hsv2rgbScalar(h, s, v, r, g, b, count);
+		break;
+	}
+}
+
+void hsv2rgb(const float* h, const float* s, const float* v, float* r, float* g, float* b, size_t count)
+{
+	static const ColorConvIsa best =
+		isColorConvIsaSupported(COLORCONV_AVX2) ? COLORCONV_AVX2 :
+		isColorConvIsaSupported(COLORCONV_SSE2) ? COLORCONV_SSE2 : COLORCONV_SCALAR;
+
+	hsv2rgb(best, h, s, v, r, g, b, count);
+}
+
+void benchmarkHsv2rgb(size_t count)
+{
+	typedef std::chrono::high_resolution_clock Clock;
+
+	if (count == 0)
+		count = 1;
+
+	std::vector<float> h(count), s(count), v(count);
+	std::vector<float> r(count), g(count), b(count);
+
+	// Hue across several turns so the wrap is exercised too
+	unsigned int state = 0x9E3779B9u;
+	for (size_t i = 0; i < count; i++)
+	{
+		float random[3];
+		for (int c = 0; c < 3; c++)
+		{
+			state ^= state << 13;
+			state ^= state >> 17;
+			state ^= state << 5;
+			random[c] = (state & 0xFFFFFF) / (float)0x1000000;
+		}
+
+		h[i] = random[0] * 3.0f;
+		s[i] = random[1];
+		v[i] = random[2];
+	}
+
+	printf("HSV to RGB, %zu colors per batch\n", count);
+	printf("%-8s %14s %12s\n", "ISA", "Mconv/s", "Max error");
+
+	for (int isa = 0; isa < COLORCONV_ISA_COUNT; isa++)
+	{
+		if (!isColorConvIsaSupported((ColorConvIsa)isa))
+		{
+			printf("%-8s %14s\n", isaNames[isa], "unsupported");
+			continue;
+		}
+
+		hsv2rgb((ColorConvIsa)isa, h.data(), s.data(), v.data(), r.data(), g.data(), b.data(), count);
+
+		// ImGui wants the hue in [0, 1), wrap it the same way before comparing
+		float maxError = 0.0f;
+		for (size_t i = 0; i < count; i++)
+		{
+			float expected[3];
+			ImGui::ColorConvertHSVtoRGB(h[i] - floorf(h[i]), s[i], v[i], expected[0], expected[1], expected[2]);
+
+			maxError = fmaxf(maxError, fabsf(expected[0] - r[i]));
+			maxError = fmaxf(maxError, fabsf(expected[1] - g[i]));
+			maxError = fmaxf(maxError, fabsf(expected[2] - b[i]));
+		}
+
+		// Repeat for at least a quarter second
+		size_t converted = 0;
+		Clock::time_point start = Clock::now();
+		double elapsed = 0.0;
+		do
+		{
+			hsv2rgb((ColorConvIsa)isa, h.data(), s.data(), v.data(), r.data(), g.data(), b.data(), count);
+			converted += count;
+			elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+		} while (elapsed < 0.25);
+
+		printf("%-8s %14.1f %12g\n", isaNames[isa], converted / elapsed / 1000000.0, maxError);
+	}
+}
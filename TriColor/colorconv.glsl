@@ -0,0 +1,14 @@
+// Same formula as hsv2rgb in colorconv.cpp
+vec3 hsv2rgb(vec3 c)
+{
+	vec3 k = mod(vec3(5.0, 3.0, 1.0) + fract(c.x) * 6.0, 6.0);
+	return c.z - c.z * c.y * clamp(min(k, 4.0 - k), 0.0, 1.0);
+}
+
+// Tint of instance "index" in the color animation at "time". The phase is the golden ratio in
+// 0.32 fixed point, the same phase Scene gives each entity on the CPU.
+vec3 waveTint(uint index, float time)
+{
+	float phase = float((index * 2654435769u) >> 8) / 16777216.0;
+	return hsv2rgb(vec3(0.5 + 0.5 * sin(time) + phase, 1.0, 1.0));
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#ifndef COLORCONV_H
+#define COLORCONV_H
+#include <cstddef>
+
+enum ColorConvIsa
+{
+	COLORCONV_SCALAR,
+	COLORCONV_SSE2,
+	COLORCONV_AVX2,
+	COLORCONV_ISA_COUNT
+};
+
+/*
+Convert "count" colors from HSV to RGB, every component in [0, 1]. Hue wraps around, so
+1.25 is the same as 0.25. Inputs and outputs are separate arrays (structure of arrays),
+r/g/b must not alias h/s/v.
+
+Uses the widest instruction set the CPU supports. All paths evaluate the same formula
+and agree with ImGui::ColorConvertHSVtoRGB to within float rounding.
+*/
+void hsv2rgb(const float* h, const float* s, const float* v, float* r, float* g, float* b, size_t count);
+
+// Same, forced onto one instruction set. Must be supported, see isColorConvIsaSupported.
+void hsv2rgb(ColorConvIsa isa, const float* h, const float* s, const float* v, float* r, float* g, float* b, size_t count);
+
+bool isColorConvIsaSupported(ColorConvIsa isa);
+const char* getColorConvIsaName(ColorConvIsa isa);
+
+/*
+Microbenchmark: conversions per second of every supported instruction set and the largest
+difference to ImGui::ColorConvertHSVtoRGB, printed to stdout.
+*/
+void benchmarkHsv2rgb(size_t count);
+
+#endif // !COLORCONV_H
@@ -0,0 +1,276 @@
+#include "culling.h"
+#include "glextensions.h"
+#include "log.h"
+
+#include <vector>
+
+// Defines picking the pass out of CULL_SHADER_PATH, in dispatch order
+static const char* passDefines[3] = { "CULL_PASS_COUNT", "CULL_PASS_SCAN", "CULL_PASS_WRITE" };
+
+/*
+Info log of a shader or program object.
+*/
+static string getInfoLog(unsigned int object, bool isProgram)
+{
+	int length = 0;
+	if (isProgram)
+		glGetProgramiv(object, GL_INFO_LOG_LENGTH, &length);
+	else
+		glGetShaderiv(object, GL_INFO_LOG_LENGTH, &length);
+
+	if (length <= 0)
+		return string();
+
+	std::vector<char> infoLog(length);
+	if (isProgram)
+		glGetProgramInfoLog(object, length, NULL, infoLog.data());
+	else
+		glGetShaderInfoLog(object, length, NULL, infoLog.data());
+
+	return string(infoLog.data());
+}
+
+/*
+Compile and link one compute program, 0 on failure.
+*/
+static unsigned int buildComputeProgram(const string& source)
+{
+	const char* code = source.c_str();
+	unsigned int shader = glCreateShader(GL_COMPUTE_SHADER);
+	glShaderSource(shader, 1, &code, NULL);
+	glCompileShader(shader);
+
+	int success;
+	glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+	if (!success)
+	{
+		LOG_ERROR("Compute shader compilation failed.\n%s", getInfoLog(shader, false).c_str());
+		glDeleteShader(shader);
+		return 0;
+	}
+
+	unsigned int program = glCreateProgram();
+	glAttachShader(program, shader);
+	glLinkProgram(program);
+	glDeleteShader(shader);
+
+	glGetProgramiv(program, GL_LINK_STATUS, &success);
+	if (!success)
+	{
+		LOG_ERROR("Compute program linking failed.\n%s", getInfoLog(program, true).c_str());
+		glDeleteProgram(program);
+		return 0;
+	}
+
+	return program;
+}
+
+InstanceCuller::InstanceCuller()
+{
+	for (int i = 0; i < 3; i++)
+	{
+		programs[i] = 0;
+		uniforms[i] = { -1, -1, -1, -1, -1, -1 };
+	}
+
+	outputBuffer = 0;
+	countBuffer = 0;
+	groupCountBuffer = 0;
+	capacity = 0;
+
+	for (int i = 0; i < CULL_READBACK_FRAMES; i++)
+	{
+		readbackBuffers[i] = 0;
+		readbackFences[i] = NULL;
+		readbackTotals[i] = 0;
+	}
+	frame = 0;
+
+	drawnCount = 0;
+	culledCount = 0;
+}
+
+InstanceCuller::~InstanceCuller()
+{
+	release();
+}
+
+bool InstanceCuller::init(ShaderLibrary& library)
+{
+	if (!GLExt.computeShader)
+		return false;
+
+	unsigned int built[3] = { 0, 0, 0 };
+	for (int pass = 0; pass < 3; pass++)
+	{
+		string source, error;
+		if (library.preprocess(CULL_SHADER_PATH, { passDefines[pass] }, source, files, error))
+			built[pass] = buildComputeProgram(source);
+		else
+			LOG_ERROR("%s", error.c_str());
+
+		if (built[pass] == 0)
+		{
+			LOG_ERROR("Failed to build %s (%s).", CULL_SHADER_PATH, passDefines[pass]);
+			for (int i = 0; i < pass; i++)
+				glDeleteProgram(built[i]);
+			return false;
+		}
+	}
+
+	for (int pass = 0; pass < 3; pass++)
+	{
+		if (programs[pass] != 0)
+			glDeleteProgram(programs[pass]);
+		programs[pass] = built[pass];
+
+		// Locations can move between builds, so they're looked up again on every reload
+		unsigned int program = programs[pass];
+		CullUniforms& passUniforms = uniforms[pass];
+		passUniforms.count = glGetUniformLocation(program, "uCount");
+		passUniforms.position = glGetUniformLocation(program, "uPos");
+		passUniforms.scale = glGetUniformLocation(program, "uScale");
+		passUniforms.minScale = glGetUniformLocation(program, "uMinScale");
+		passUniforms.animate = glGetUniformLocation(program, "uAnimate");
+		passUniforms.time = glGetUniformLocation(program, "uTime");
+	}
+
+	// Everything else is made once, only the programs change on a reload
+	if (countBuffer == 0)
+	{
+		unsigned int survivors = 0;
+		glGenBuffers(1, &countBuffer);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, countBuffer);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(survivors), &survivors, GL_DYNAMIC_COPY);
+
+		glGenBuffers(1, &outputBuffer);
+		glGenBuffers(1, &groupCountBuffer);
+
+		glGenBuffers(CULL_READBACK_FRAMES, readbackBuffers);
+		for (int i = 0; i < CULL_READBACK_FRAMES; i++)
+		{
+			glBindBuffer(GL_COPY_WRITE_BUFFER, readbackBuffers[i]);
+			glBufferData(GL_COPY_WRITE_BUFFER, sizeof(unsigned int), NULL, GL_STREAM_READ);
+		}
+
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	}
+
+	return true;
+}
+
+void InstanceCuller::cull(unsigned int buffer, GLintptr offset, size_t count, const SceneView& view, bool animate, float time)
+{
+	if (!isSupported() || count == 0)
+		return;
+
+	readBack();
+
+	size_t groups = (count + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE;
+
+	// Sized for the largest count so far, only grows
+	if (count > capacity)
+	{
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, outputBuffer);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, count * sizeof(TriangleInstance), NULL, GL_DYNAMIC_COPY);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, groupCountBuffer);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, groups * sizeof(unsigned int), NULL, GL_DYNAMIC_COPY);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+		capacity = count;
+	}
+
+	glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 0, buffer, offset, count * sizeof(TriangleInstance));
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, outputBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, countBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, groupCountBuffer);
+
+	for (int pass = 0; pass < 3; pass++)
+	{
+		const CullUniforms& passUniforms = uniforms[pass];
+		glUseProgram(programs[pass]);
+		glUniform1ui(passUniforms.count, (unsigned int)count);
+		glUniform2f(passUniforms.position, view.position[0], view.position[1]);
+		glUniform1f(passUniforms.scale, view.scale);
+		glUniform1f(passUniforms.minScale, view.minScale);
+		glUniform1i(passUniforms.animate, animate ? 1 : 0);
+		glUniform1f(passUniforms.time, time);
+
+		// The scan is a single group, the others one invocation per instance
+		GLExt.DispatchCompute(pass == 1 ? 1 : (GLuint)groups, 1, 1);
+		GLExt.MemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+	}
+
+	// The draw reads the instances, the count is copied into its command and for the stats
+	GLExt.MemoryBarrier(GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+
+	int slot = frame % CULL_READBACK_FRAMES;
+	glBindBuffer(GL_COPY_READ_BUFFER, countBuffer);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, readbackBuffers[slot]);
+	glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, sizeof(unsigned int));
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+	if (readbackFences[slot] != NULL)
+		glDeleteSync(readbackFences[slot]);
+	readbackFences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	readbackTotals[slot] = count;
+	frame++;
+
+	for (int i = 0; i < 4; i++)
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, i, 0);
+	glUseProgram(0);
+}
+
+void InstanceCuller::readBack()
+{
+	// The oldest copy, about to be reused by this frame
+	int slot = frame % CULL_READBACK_FRAMES;
+	if (readbackFences[slot] == NULL)
+		return;
+
+	// Only if it's done, a count from a later frame comes along soon enough
+	if (glClientWaitSync(readbackFences[slot], 0, 0) == GL_TIMEOUT_EXPIRED)
+		return;
+
+	unsigned int drawn = 0;
+	glBindBuffer(GL_COPY_READ_BUFFER, readbackBuffers[slot]);
+	glGetBufferSubData(GL_COPY_READ_BUFFER, 0, sizeof(drawn), &drawn);
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+
+	drawnCount = drawn;
+	culledCount = readbackTotals[slot] - drawn;
+}
+
+void InstanceCuller::release()
+{
+	for (int i = 0; i < 3; i++)
+	{
+		if (programs[i] != 0)
+			glDeleteProgram(programs[i]);
+		programs[i] = 0;
+		uniforms[i] = { -1, -1, -1, -1, -1, -1 };
+	}
+
+	for (int i = 0; i < CULL_READBACK_FRAMES; i++)
+	{
+		if (readbackFences[i] != NULL)
+			glDeleteSync(readbackFences[i]);
+		readbackFences[i] = NULL;
+	}
+
+	if (countBuffer != 0)
+	{
+		glDeleteBuffers(1, &countBuffer);
+		glDeleteBuffers(1, &outputBuffer);
+		glDeleteBuffers(1, &groupCountBuffer);
+		glDeleteBuffers(CULL_READBACK_FRAMES, readbackBuffers);
+	}
+
+	countBuffer = 0;
+	outputBuffer = 0;
+	groupCountBuffer = 0;
+	for (int i = 0; i < CULL_READBACK_FRAMES; i++)
+		readbackBuffers[i] = 0;
+	capacity = 0;
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#ifndef CULLING_H
+#define CULLING_H
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "scene.h"
+#include "shaderlibrary.h"
+
+typedef std::string string;
+
+#define CULL_SHADER_PATH "CullCompute.glsl"
+// Invocations per workgroup, GROUP_SIZE in CullCompute.glsl
+#define CULL_GROUP_SIZE 256
+// Frames the drawn count is read back after, so reading it never waits on the GPU
+#define CULL_READBACK_FRAMES 3
+
+/*
+Where the triangle instances are tested against the view.
+*/
+enum CullMode
+{
+	CULL_OFF,
+	// InstanceCuller, the CPU never sees which instances survive
+	CULL_GPU,
+	// Scene::writeVisibleInstances, when there are no compute shaders
+	CULL_CPU
+};
+
+/*
+Culls the triangle instances on the GPU with compute shaders (GL 4.3). The survivors and their
+count stay on the GPU, DrawBatcher copies the count into an indirect draw command.
+
+The survivors keep their order, overlapping triangles are drawn in the same order as without
+culling. That takes three dispatches from CullCompute.glsl: count the survivors per group,
+scan the counts in one group (it also writes the total), then write every survivor at its
+group's offset plus its place inside the group.
+
+The color animation is applied while writing, an instance's gl_InstanceID no longer says which
+triangle it is. Draw with the plain triangle shader.
+
+The drawn count for the stats is copied out and read CULL_READBACK_FRAMES frames later.
+*/
+class InstanceCuller
+{
+public:
+	InstanceCuller();
+	~InstanceCuller();
+
+	InstanceCuller(const InstanceCuller&) = delete;
+	InstanceCuller& operator=(const InstanceCuller&) = delete;
+
+	// Build the programs, again to reload them. False if compute shaders aren't supported or a
+	// pass fails to build, the last good programs stay in use then.
+	bool init(ShaderLibrary& library);
+	bool isSupported() const { return programs[0] != 0; }
+
+	/*
+	Cull "count" instances at "offset" in "buffer", which must be a multiple of
+	GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT. "animate" replaces the tints with the wave at "time".
+	*/
+	void cull(unsigned int buffer, GLintptr offset, size_t count, const SceneView& view, bool animate, float time);
+
+	// The survivors of the last cull(), TriangleInstance records, and their number as an unsigned int
+	unsigned int getOutputBuffer() const { return outputBuffer; }
+	unsigned int getCountBuffer() const { return countBuffer; }
+	// Instances drawn and culled, as of CULL_READBACK_FRAMES frames ago
+	size_t getDrawnCount() const { return drawnCount; }
+	size_t getCulledCount() const { return culledCount; }
+	// Files the programs were built from, for the file watcher
+	const std::vector<string>& getFiles() const { return files; }
+
+	void release();
+
+private:
+	// Uniform locations of a pass, -1 for those it doesn't use
+	struct CullUniforms
+	{
+		int count;
+		int position;
+		int scale;
+		int minScale;
+		int animate;
+		int time;
+	};
+
+	// One program per pass, and its uniforms looked up when it was built
+	unsigned int programs[3];
+	CullUniforms uniforms[3];
+	unsigned int outputBuffer;
+	unsigned int countBuffer;
+	unsigned int groupCountBuffer;
+	size_t capacity;
+
+	unsigned int readbackBuffers[CULL_READBACK_FRAMES];
+	GLsync readbackFences[CULL_READBACK_FRAMES];
+	size_t readbackTotals[CULL_READBACK_FRAMES];
+	int frame;
+
+	size_t drawnCount;
+	size_t culledCount;
+	std::vector<string> files;
+
+	void readBack();
+};
+
+#endif // !CULLING_H
@@ -0,0 +1,67 @@
+#include "filewatcher.h"
+
+#include <chrono>
+
+static std::filesystem::file_time_type lastWriteTime(const string& path)
+{
+	// Missing files (e.g. in the middle of an editor's save) read as the minimum time
+	std::error_code error;
+	std::filesystem::file_time_type time = std::filesystem::last_write_time(path, error);
+	return error ? std::filesystem::file_time_type::min() : time;
+}
+
+FileWatcher::FileWatcher()
+	: changed(false), running(true)
+{
+	thread = std::thread(&FileWatcher::run, this);
+}
+
+FileWatcher::~FileWatcher()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		running = false;
+	}
+	wake.notify_one();
+	thread.join();
+}
+
+void FileWatcher::watch(const string& path)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	files.push_back({ path, lastWriteTime(path) });
+}
+
+void FileWatcher::setCallback(std::function<void()> callback)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	this->callback = callback;
+}
+
+bool FileWatcher::poll()
+{
+	return changed.exchange(false);
+}
+
+void FileWatcher::run()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+
+	while (running)
+	{
+		wake.wait_for(lock, std::chrono::milliseconds(FILE_WATCHER_INTERVAL_MS));
+
+		for (WatchedFile& file : files)
+		{
+			std::filesystem::file_time_type time = lastWriteTime(file.path);
+			if (time != file.lastWrite && time != std::filesystem::file_time_type::min())
+			{
+				file.lastWrite = time;
+				changed = true;
+
+				if (callback)
+					callback();
+			}
+		}
+	}
+}
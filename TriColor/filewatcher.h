@@ -0,0 +1,60 @@
+#pragma once
+
+#ifndef FILEWATCHER_H
+#define FILEWATCHER_H
+#include <atomic>
+#include <condition_variable>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+typedef std::string string;
+
+#define FILE_WATCHER_INTERVAL_MS 250
+
+/*
+Watches a set of files from a background thread and raises a flag when one of them
+is modified, so the render thread never touches the file system to find out.
+*/
+class FileWatcher
+{
+public:
+	FileWatcher();
+	~FileWatcher();
+
+	FileWatcher(const FileWatcher&) = delete;
+	FileWatcher& operator=(const FileWatcher&) = delete;
+
+	void watch(const string& path);
+
+	// True if any watched file changed since the last call
+	bool poll();
+	// Same as poll() without clearing the flag
+	bool pending() const { return changed; }
+
+	// Called from the watcher thread when a change is found, e.g. to wake up a sleeping
+	// event loop. Set it before watching files.
+	void setCallback(std::function<void()> callback);
+
+private:
+	struct WatchedFile
+	{
+		string path;
+		std::filesystem::file_time_type lastWrite;
+	};
+
+	std::vector<WatchedFile> files;
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::thread thread;
+	std::atomic<bool> changed;
+	bool running;
+	std::function<void()> callback;
+
+	void run();
+};
+
+#endif // !FILEWATCHER_H
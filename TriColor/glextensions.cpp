@@ -0,0 +1,83 @@
+#include "glextensions.h"
+
+#include <cstring>
+
+GLExtensions GLExt = {};
+
+bool hasGLVersion(int major, int minor)
+{
+	return GLVersion.major > major || (GLVersion.major == major && GLVersion.minor >= minor);
+}
+
+bool hasGLExtension(const char* name)
+{
+	int count = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+
+	for (int i = 0; i < count; i++)
+	{
+		const char* extension = (const char*)glGetStringi(GL_EXTENSIONS, i);
+		if (extension != NULL && strcmp(extension, name) == 0)
+			return true;
+	}
+
+	return false;
+}
+
+void loadGLExtensions(GLADloadproc load)
+{
+	GLExt = {};
+
+	// Buffer storage
+	if (hasGLVersion(4, 4) || hasGLExtension("GL_ARB_buffer_storage"))
+	{
+		GLExt.BufferStorage = (decltype(GLExt.BufferStorage))load("glBufferStorage");
+		GLExt.bufferStorage = GLExt.BufferStorage != NULL;
+	}
+
+	// Program binaries, only useful if the driver offers at least one format
+	int binaryFormats = 0;
+	if (hasGLVersion(4, 1) || hasGLExtension("GL_ARB_get_program_binary"))
+	{
+		GLExt.GetProgramBinary = (decltype(GLExt.GetProgramBinary))load("glGetProgramBinary");
+		GLExt.ProgramBinary = (decltype(GLExt.ProgramBinary))load("glProgramBinary");
+		GLExt.ProgramParameteri = (decltype(GLExt.ProgramParameteri))load("glProgramParameteri");
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &binaryFormats);
+		GLExt.programBinary = GLExt.GetProgramBinary != NULL && GLExt.ProgramBinary != NULL
+			&& GLExt.ProgramParameteri != NULL && binaryFormats > 0;
+	}
+
+	// Compute shaders and storage buffers both come with 4.3, only used together
+	if (hasGLVersion(4, 3))
+	{
+		GLExt.DispatchCompute = (decltype(GLExt.DispatchCompute))load("glDispatchCompute");
+		GLExt.MemoryBarrier = (decltype(GLExt.MemoryBarrier))load("glMemoryBarrier");
+		GLExt.computeShader = GLExt.DispatchCompute != NULL && GLExt.MemoryBarrier != NULL;
+	}
+
+	// Indirect draws
+	if (hasGLVersion(4, 0) || hasGLExtension("GL_ARB_draw_indirect"))
+	{
+		GLExt.DrawElementsIndirect = (decltype(GLExt.DrawElementsIndirect))load("glDrawElementsIndirect");
+		GLExt.drawIndirect = GLExt.DrawElementsIndirect != NULL;
+	}
+
+	// Multi draw indirect, the shaders need storage buffers (GLSL 4.30) and gl_DrawID
+	if (hasGLVersion(4, 3) && (hasGLVersion(4, 6) || hasGLExtension("GL_ARB_shader_draw_parameters")))
+	{
+		GLExt.MultiDrawElementsIndirect = (decltype(GLExt.MultiDrawElementsIndirect))load("glMultiDrawElementsIndirect");
+		GLExt.multiDrawIndirect = GLExt.MultiDrawElementsIndirect != NULL;
+	}
+
+	// Parallel shader compile, let the driver pick the number of threads
+	if (hasGLExtension("GL_KHR_parallel_shader_compile"))
+		GLExt.MaxShaderCompilerThreads = (decltype(GLExt.MaxShaderCompilerThreads))load("glMaxShaderCompilerThreadsKHR");
+	else if (hasGLExtension("GL_ARB_parallel_shader_compile"))
+		GLExt.MaxShaderCompilerThreads = (decltype(GLExt.MaxShaderCompilerThreads))load("glMaxShaderCompilerThreadsARB");
+
+	if (GLExt.MaxShaderCompilerThreads != NULL)
+	{
+		GLExt.MaxShaderCompilerThreads(0xFFFFFFFF);
+		GLExt.parallelShaderCompile = true;
+	}
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#ifndef GLEXTENSIONS_H
+#define GLEXTENSIONS_H
+#include <glad/glad.h>
+
+/*
+The bundled glad loader only covers OpenGL 3.3 core. Anything newer is optional and loaded here
+after the context is created, every feature has a flag that must be checked before its
+entry points are called.
+*/
+
+// GL 4.4 / ARB_buffer_storage
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#endif
+#ifndef GL_MAP_COHERENT_BIT
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+#ifndef GL_DYNAMIC_STORAGE_BIT
+#define GL_DYNAMIC_STORAGE_BIT 0x0100
+#endif
+#ifndef GL_CLIENT_STORAGE_BIT
+#define GL_CLIENT_STORAGE_BIT 0x0200
+#endif
+
+// GL 4.1 / ARB_get_program_binary
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#endif
+#ifndef GL_PROGRAM_BINARY_LENGTH
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#endif
+#ifndef GL_NUM_PROGRAM_BINARY_FORMATS
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+
+// GL 4.3 / ARB_compute_shader, ARB_shader_storage_buffer_object, ARB_draw_indirect
+#ifndef GL_COMPUTE_SHADER
+#define GL_COMPUTE_SHADER 0x91B9
+#endif
+#ifndef GL_SHADER_STORAGE_BUFFER
+#define GL_SHADER_STORAGE_BUFFER 0x90D2
+#endif
+#ifndef GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT
+#define GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT 0x90DF
+#endif
+#ifndef GL_DRAW_INDIRECT_BUFFER
+#define GL_DRAW_INDIRECT_BUFFER 0x8F3F
+#endif
+#ifndef GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT
+#define GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT 0x00000001
+#endif
+#ifndef GL_BUFFER_UPDATE_BARRIER_BIT
+#define GL_BUFFER_UPDATE_BARRIER_BIT 0x00000200
+#endif
+#ifndef GL_SHADER_STORAGE_BARRIER_BIT
+#define GL_SHADER_STORAGE_BARRIER_BIT 0x00002000
+#endif
+
+// KHR_parallel_shader_compile
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+struct GLExtensions
+{
+	// GL 4.4 / ARB_buffer_storage
+	bool bufferStorage;
+	void (APIENTRYP BufferStorage)(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags);
+
+	// GL 4.1 / ARB_get_program_binary
+	bool programBinary;
+	void (APIENTRYP GetProgramBinary)(GLuint program, GLsizei bufSize, GLsizei* length, GLenum* binaryFormat, void* binary);
+	void (APIENTRYP ProgramBinary)(GLuint program, GLenum binaryFormat, const void* binary, GLsizei length);
+	void (APIENTRYP ProgramParameteri)(GLuint program, GLenum pname, GLint value);
+
+	// GL 4.3, compute shaders writing storage buffers
+	bool computeShader;
+	void (APIENTRYP DispatchCompute)(GLuint groupsX, GLuint groupsY, GLuint groupsZ);
+	void (APIENTRYP MemoryBarrier)(GLbitfield barriers);
+
+	// GL 4.0 / ARB_draw_indirect, draw parameters read from GL_DRAW_INDIRECT_BUFFER
+	bool drawIndirect;
+	void (APIENTRYP DrawElementsIndirect)(GLenum mode, GLenum type, const void* indirect);
+
+	// GL 4.3 with GL 4.6 / ARB_shader_draw_parameters, many draws from one call, each
+	// finding its own data by gl_DrawID
+	bool multiDrawIndirect;
+	void (APIENTRYP MultiDrawElementsIndirect)(GLenum mode, GLenum type, const void* indirect, GLsizei drawCount, GLsizei stride);
+
+	// KHR_parallel_shader_compile (or the ARB version), compiles run on driver threads
+	// and GL_COMPLETION_STATUS_KHR can be queried without blocking
+	bool parallelShaderCompile;
+	void (APIENTRYP MaxShaderCompilerThreads)(GLuint count);
+};
+
+extern GLExtensions GLExt;
+
+/*
+Load the optional entry points for the current context. Call once after gladLoadGLLoader.
+*/
+void loadGLExtensions(GLADloadproc load);
+
+/*
+Check whether the current context is at least version major.minor.
+*/
+bool hasGLVersion(int major, int minor);
+
+/*
+Check whether the current context exposes the given extension, e.g. "GL_ARB_buffer_storage".
+*/
+bool hasGLExtension(const char* name);
+
+#endif // !GLEXTENSIONS_H
@@ -19,6 +19,11 @@
 
 // CHANGELOG
 // (minor and older changes stripped away, please see git history for details)
+//  2026-10-18: OpenGL: Added ImGui_ImplOpenGL3_Flags_ShaderClip to clip in the fragment shader, merging consecutive draw commands that use the same texture.
+//  2026-10-18: OpenGL: Added ImGui_ImplOpenGL3_Flags_AppOwnsState to skip querying and restoring GL state around rendering.
+//  2026-10-18: OpenGL: Skip glScissor()/glBindTexture() calls matching the previous command. Added ImGui_ImplOpenGL3_GetRenderStats() to count them, draw calls and uploaded bytes.
+//  2026-10-18: OpenGL: Added ImGui_ImplOpenGL3_Flags_SingleUpload to copy all draw lists into one staging buffer, uploaded once per frame and drawn with base vertex/index offsets.
+//  2026-10-18: OpenGL: Keep the VAO in the backend data with its attributes set up once, instead of recreating it every frame. Added ImGui_ImplOpenGL3_Flags_MultipleContexts to Init() for the old behavior.
 //  2023-06-20: OpenGL: Fixed erroneous use glGetIntegerv(GL_CONTEXT_PROFILE_MASK) on contexts lower than 3.2. (#6539, #6333)
 //  2023-05-09: OpenGL: Support for glBindSampler() backup/restore on ES3. (#6375)
 //  2023-04-18: OpenGL: Restore front and back polygon mode separately when supported by context. (#6333)
@@ -190,6 +195,13 @@
 #define IMGUI_IMPL_OPENGL_MAY_HAVE_PRIMITIVE_RESTART
 #endif
 
+// Desktop GL 3.2+ can clip in the fragment shader: uniform blocks, integer vertex attributes and glDrawElementsBaseVertex()
+#if defined(IMGUI_IMPL_OPENGL_MAY_HAVE_VTX_OFFSET) && defined(GL_UNIFORM_BUFFER)
+#define IMGUI_IMPL_OPENGL_MAY_HAVE_SHADER_CLIP
+#define IMGUI_IMPL_OPENGL_CLIP_RECTS    1024    // Clip rectangles in the uniform block, 16 KB: the smallest GL_MAX_UNIFORM_BLOCK_SIZE allowed
+#define IMGUI_IMPL_OPENGL_CLIP_BINDING  0       // Uniform buffer binding point of the clip rectangles, not restored after rendering
+#endif
+
 // Desktop GL use extension detection
 #if !defined(IMGUI_IMPL_OPENGL_ES2) && !defined(IMGUI_IMPL_OPENGL_ES3)
 #define IMGUI_IMPL_OPENGL_MAY_HAVE_EXTENSIONS
@@ -209,6 +221,7 @@ struct ImGui_ImplOpenGL3_Data
 {
     GLuint          GlVersion;               // Extracted at runtime using GL_MAJOR_VERSION, GL_MINOR_VERSION queries (e.g. 320 for GL 3.2)
     char            GlslVersionString[32];   // Specified by user or detected based on compile time GL settings.
+    ImGui_ImplOpenGL3_Flags Flags;           // Specified by user in ImGui_ImplOpenGL3_Init()
     bool            GlProfileIsES2;
     bool            GlProfileIsES3;
     bool            GlProfileIsCompat;
@@ -221,10 +234,26 @@ struct ImGui_ImplOpenGL3_Data
     GLuint          AttribLocationVtxUV;
     GLuint          AttribLocationVtxColor;
     unsigned int    VboHandle, ElementsHandle;
+    GLuint          VaoHandle;               // Made once with the attributes set up, 0 with ImGui_ImplOpenGL3_Flags_MultipleContexts or without vertex arrays
     GLsizeiptr      VertexBufferSize;
     GLsizeiptr      IndexBufferSize;
     bool            HasClipOrigin;
     bool            UseBufferSubData;
+    bool            UseSingleUpload;         // ImGui_ImplOpenGL3_Flags_SingleUpload and glDrawElementsBaseVertex() is available
+    ImVector<char>  UploadBuffer;            // Staging copy of every draw list for UseSingleUpload: all vertices, then all indices
+    GLuint          ShadowTexture;           // Last texture and scissor rectangle set while rendering, valid when Has* is set
+    GLint           ShadowScissor[4];
+    bool            HasShadowTexture;
+    bool            HasShadowScissor;
+    ImGui_ImplOpenGL3_RenderStats RenderStats;
+    bool            UseShaderClip;           // ImGui_ImplOpenGL3_Flags_ShaderClip with desktop GLSL 330+, implies UseSingleUpload
+    GLuint          ClipIndexHandle;         // Clip rectangle of every vertex, an index within its window of ClipRectsHandle
+    GLuint          ClipRectsHandle;         // Uniform buffer of clip rectangles, bound IMGUI_IMPL_OPENGL_CLIP_RECTS at a time
+    GLuint          AttribLocationVtxClip;
+    int             ShadowClipWindow;        // Window of ClipRectsHandle bound while rendering, -1 if unknown
+    ImVector<ImU16> ClipIndices;             // Staging copies of ClipIndexHandle and ClipRectsHandle
+    ImVector<float> ClipRects;
+    ImVector<int>   ClipWindows;             // Window of the clip rectangle of every drawn command, in drawing order
 
     ImGui_ImplOpenGL3_Data() { memset((void*)this, 0, sizeof(*this)); }
 };
@@ -260,8 +289,140 @@ struct ImGui_ImplOpenGL3_VtxAttribState
 };
 #endif
 
+// GL state modified by ImGui_ImplOpenGL3_RenderDrawData(), backed up and restored around it unless ImGui_ImplOpenGL3_Flags_AppOwnsState is set
+struct ImGui_ImplOpenGL3_StateBackup
+{
+    GLenum                           last_active_texture;
+    GLuint                           last_program;
+    GLuint                           last_texture;
+#ifdef IMGUI_IMPL_OPENGL_MAY_HAVE_BIND_SAMPLER
+    GLuint                           last_sampler;
+#endif
+    GLuint                           last_array_buffer;
+#ifndef IMGUI_IMPL_OPENGL_USE_VERTEX_ARRAY
+    GLint                            last_element_array_buffer;
+    ImGui_ImplOpenGL3_VtxAttribState last_vtx_attrib_state_pos;
+    ImGui_ImplOpenGL3_VtxAttribState last_vtx_attrib_state_uv;
+    ImGui_ImplOpenGL3_VtxAttribState last_vtx_attrib_state_color;
+#endif
+#ifdef IMGUI_IMPL_OPENGL_USE_VERTEX_ARRAY
+    GLuint                           last_vertex_array_object;
+#endif
+#ifdef IMGUI_IMPL_HAS_POLYGON_MODE
+    GLint                            last_polygon_mode[2];
+#endif
+    GLint                            last_viewport[4];
+    GLint                            last_scissor_box[4];
+    GLenum                           last_blend_src_rgb;
+    GLenum                           last_blend_dst_rgb;
+    GLenum                           last_blend_src_alpha;
+    GLenum                           last_blend_dst_alpha;
+    GLenum                           last_blend_equation_rgb;
+    GLenum                           last_blend_equation_alpha;
+    GLboolean                        last_enable_blend;
+    GLboolean                        last_enable_cull_face;
+    GLboolean                        last_enable_depth_test;
+    GLboolean                        last_enable_stencil_test;
+    GLboolean                        last_enable_scissor_test;
+#ifdef IMGUI_IMPL_OPENGL_MAY_HAVE_PRIMITIVE_RESTART
+    GLboolean                        last_enable_primitive_restart;
+#endif
+
+    void Backup()
+    {
+        ImGui_ImplOpenGL3_Data* bd = ImGui_ImplOpenGL3_GetBackendData();
+        glGetIntegerv(GL_ACTIVE_TEXTURE, (GLint*)&last_active_texture);
+        glActiveTexture(GL_TEXTURE0);
+        glGetIntegerv(GL_CURRENT_PROGRAM, (GLint*)&last_program);
+        glGetIntegerv(GL_TEXTURE_BINDING_2D, (GLint*)&last_texture);
+#ifdef IMGUI_IMPL_OPENGL_MAY_HAVE_BIND_SAMPLER
+        if (bd->GlVersion >= 330 || bd->GlProfileIsES3) { glGetIntegerv(GL_SAMPLER_BINDING, (GLint*)&last_sampler); } else { last_sampler = 0; }
+#endif
+        glGetIntegerv(GL_ARRAY_BUFFER_BINDING, (GLint*)&last_array_buffer);
+#ifndef IMGUI_IMPL_OPENGL_USE_VERTEX_ARRAY
+        // This is part of VAO on OpenGL 3.0+ and OpenGL ES 3.0+.
+        glGetIntegerv(GL_ELEMENT_ARRAY_BUFFER_BINDING, &last_element_array_buffer);
+        last_vtx_attrib_state_pos.GetState(bd->AttribLocationVtxPos);
+        last_vtx_attrib_state_uv.GetState(bd->AttribLocationVtxUV);
+        last_vtx_attrib_state_color.GetState(bd->AttribLocationVtxColor);
+#endif
+#ifdef IMGUI_IMPL_OPENGL_USE_VERTEX_ARRAY
+        glGetIntegerv(GL_VERTEX_ARRAY_BINDING, (GLint*)&last_vertex_array_object);
+#endif
+#ifdef IMGUI_IMPL_HAS_POLYGON_MODE
+        glGetIntegerv(GL_POLYGON_MODE, last_polygon_mode);
+#endif
+        glGetIntegerv(GL_VIEWPORT, last_viewport);
+        glGetIntegerv(GL_SCISSOR_BOX, last_scissor_box);
+        glGetIntegerv(GL_BLEND_SRC_RGB, (GLint*)&last_blend_src_rgb);
+        glGetIntegerv(GL_BLEND_DST_RGB, (GLint*)&last_blend_dst_rgb);
+        glGetIntegerv(GL_BLEND_SRC_ALPHA, (GLint*)&last_blend_src_alpha);
+        glGetIntegerv(GL_BLEND_DST_ALPHA, (GLint*)&last_blend_dst_alpha);
+        glGetIntegerv(GL_BLEND_EQUATION_RGB, (GLint*)&last_blend_equation_rgb);
+        glGetIntegerv(GL_BLEND_EQUATION_ALPHA, (GLint*)&last_blend_equation_alpha);
+        last_enable_blend = glIsEnabled(GL_BLEND);
+        last_enable_cull_face = glIsEnabled(GL_CULL_FACE);
+        last_enable_depth_test = glIsEnabled(GL_DEPTH_TEST);
+        last_enable_stencil_test = glIsEnabled(GL_STENCIL_TEST);
+        last_enable_scissor_test = glIsEnabled(GL_SCISSOR_TEST);
+#ifdef IMGUI_IMPL_OPENGL_MAY_HAVE_PRIMITIVE_RESTART
+        last_enable_primitive_restart = (bd->GlVersion >= 310) ? glIsEnabled(GL_PRIMITIVE_RESTART) : GL_FALSE;
+#endif
+        (void)bd; // Not all compilation paths use this
+    }
+    void Restore()
+    {
+        ImGui_ImplOpenGL3_Data* bd = ImGui_ImplOpenGL3_GetBackendData();
+        // This "glIsProgram()" check is required because if the program is "pending deletion" at the time of binding backup, it will have been deleted by now and will cause an OpenGL error. See #6220.
+        if (last_program == 0 || glIsProgram(last_program)) glUseProgram(last_program);
+        glBindTexture(GL_TEXTURE_2D, last_texture);
+#ifdef IMGUI_IMPL_OPENGL_MAY_HAVE_BIND_SAMPLER
+        if (bd->GlVersion >= 330 || bd->GlProfileIsES3)
+            glBindSampler(0, last_sampler);
+#endif
+        glActiveTexture(last_active_texture);
+#ifdef IMGUI_IMPL_OPENGL_USE_VERTEX_ARRAY
+        glBindVertexArray(last_vertex_array_object);
+#endif
+        glBindBuffer(GL_ARRAY_BUFFER, last_array_buffer);
+#ifndef IMGUI_IMPL_OPENGL_USE_VERTEX_ARRAY
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, last_element_array_buffer);
+        last_vtx_attrib_state_pos.SetState(bd->AttribLocationVtxPos);
+        last_vtx_attrib_state_uv.SetState(bd->AttribLocationVtxUV);
+        last_vtx_attrib_state_color.SetState(bd->AttribLocationVtxColor);
+#endif
+        glBlendEquationSeparate(last_blend_equation_rgb, last_blend_equation_alpha);
+        glBlendFuncSeparate(last_blend_src_rgb, last_blend_dst_rgb, last_blend_src_alpha, last_blend_dst_alpha);
+        if (last_enable_blend) glEnable(GL_BLEND); else glDisable(GL_BLEND);
+        if (last_enable_cull_face) glEnable(GL_CULL_FACE); else glDisable(GL_CULL_FACE);
+        if (last_enable_depth_test) glEnable(GL_DEPTH_TEST); else glDisable(GL_DEPTH_TEST);
+        if (last_enable_stencil_test) glEnable(GL_STENCIL_TEST); else glDisable(GL_STENCIL_TEST);
+        if (last_enable_scissor_test) glEnable(GL_SCISSOR_TEST); else glDisable(GL_SCISSOR_TEST);
+#ifdef IMGUI_IMPL_OPENGL_MAY_HAVE_PRIMITIVE_RESTART
+        if (bd->GlVersion >= 310) { if (last_enable_primitive_restart) glEnable(GL_PRIMITIVE_RESTART); else glDisable(GL_PRIMITIVE_RESTART); }
+#endif
+
+#ifdef IMGUI_IMPL_HAS_POLYGON_MODE
+        // Desktop OpenGL 3.0 and OpenGL 3.1 had separate polygon draw modes for front-facing and back-facing faces of polygons
+        if (bd->GlVersion <= 310 || bd->GlProfileIsCompat)
+        {
+            glPolygonMode(GL_FRONT, (GLenum)last_polygon_mode[0]);
+            glPolygonMode(GL_BACK, (GLenum)last_polygon_mode[1]);
+        }
+        else
+        {
+            glPolygonMode(GL_FRONT_AND_BACK, (GLenum)last_polygon_mode[0]);
+        }
+#endif // IMGUI_IMPL_HAS_POLYGON_MODE
+
+        glViewport(last_viewport[0], last_viewport[1], (GLsizei)last_viewport[2], (GLsizei)last_viewport[3]);
+        glScissor(last_scissor_box[0], last_scissor_box[1], (GLsizei)last_scissor_box[2], (GLsizei)last_scissor_box[3]);
+        (void)bd; // Not all compilation paths use this
+    }
+};
+
 // Functions
-bool    ImGui_ImplOpenGL3_Init(const char* glsl_version)
+bool    ImGui_ImplOpenGL3_Init(const char* glsl_version, ImGui_ImplOpenGL3_Flags flags)
 {
     ImGuiIO& io = ImGui::GetIO();
     IM_ASSERT(io.BackendRendererUserData == nullptr && "Already initialized a renderer backend!");
@@ -279,6 +440,7 @@ bool    ImGui_ImplOpenGL3_Init(const char* glsl_version)
     ImGui_ImplOpenGL3_Data* bd = IM_NEW(ImGui_ImplOpenGL3_Data)();
     io.BackendRendererUserData = (void*)bd;
     io.BackendRendererName = "imgui_impl_opengl3";
+    bd->Flags = flags;
 
     // Query for GL version (e.g. 320 for GL 3.2)
 #if defined(IMGUI_IMPL_OPENGL_ES2)
@@ -326,6 +488,8 @@ bool    ImGui_ImplOpenGL3_Init(const char* glsl_version)
 #ifdef IMGUI_IMPL_OPENGL_MAY_HAVE_VTX_OFFSET
     if (bd->GlVersion >= 320)
         io.BackendFlags |= ImGuiBackendFlags_RendererHasVtxOffset;  // We can honor the ImDrawCmd::VtxOffset field, allowing for large meshes.
+    if (bd->GlVersion >= 320)
+        bd->UseSingleUpload = (flags & (ImGui_ImplOpenGL3_Flags_SingleUpload | ImGui_ImplOpenGL3_Flags_ShaderClip)) != 0;  // Draw lists are found in the shared buffer through base vertex/index offsets.
 #endif
 
     // Store GLSL version string so we can refer to it later in case we recreate shaders.
@@ -346,6 +510,13 @@ bool    ImGui_ImplOpenGL3_Init(const char* glsl_version)
     strcpy(bd->GlslVersionString, glsl_version);
     strcat(bd->GlslVersionString, "\n");
 
+#ifdef IMGUI_IMPL_OPENGL_MAY_HAVE_SHADER_CLIP
+    // The clipping shaders need uniform blocks and integer attributes, written for desktop GLSL 330+
+    int glsl_version_number = 0;
+    sscanf(bd->GlslVersionString, "#version %d", &glsl_version_number);
+    bd->UseShaderClip = (flags & ImGui_ImplOpenGL3_Flags_ShaderClip) != 0 && bd->UseSingleUpload && glsl_version_number >= 330;
+#endif
+
     // Make an arbitrary GL call (we don't actually need the result)
     // IF YOU GET A CRASH HERE: it probably means the OpenGL function loader didn't do its job. Let us know!
     GLint current_texture;
@@ -389,6 +560,29 @@ void    ImGui_ImplOpenGL3_NewFrame()
         ImGui_ImplOpenGL3_CreateDeviceObjects();
 }
 
+// Bind vertex/index buffers and setup attributes for ImDrawVert, in the currently bound VAO if any
+static void ImGui_ImplOpenGL3_SetupVertexAttribs()
+{
+    ImGui_ImplOpenGL3_Data* bd = ImGui_ImplOpenGL3_GetBackendData();
+    GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, bd->VboHandle));
+    GL_CALL(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, bd->UseSingleUpload ? bd->VboHandle : bd->ElementsHandle)); // The single upload puts the indices after the vertices
+    GL_CALL(glEnableVertexAttribArray(bd->AttribLocationVtxPos));
+    GL_CALL(glEnableVertexAttribArray(bd->AttribLocationVtxUV));
+    GL_CALL(glEnableVertexAttribArray(bd->AttribLocationVtxColor));
+    GL_CALL(glVertexAttribPointer(bd->AttribLocationVtxPos,   2, GL_FLOAT,         GL_FALSE, sizeof(ImDrawVert), (GLvoid*)IM_OFFSETOF(ImDrawVert, pos)));
+    GL_CALL(glVertexAttribPointer(bd->AttribLocationVtxUV,    2, GL_FLOAT,         GL_FALSE, sizeof(ImDrawVert), (GLvoid*)IM_OFFSETOF(ImDrawVert, uv)));
+    GL_CALL(glVertexAttribPointer(bd->AttribLocationVtxColor, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(ImDrawVert), (GLvoid*)IM_OFFSETOF(ImDrawVert, col)));
+#ifdef IMGUI_IMPL_OPENGL_MAY_HAVE_SHADER_CLIP
+    if (bd->UseShaderClip)
+    {
+        GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, bd->ClipIndexHandle));
+        GL_CALL(glEnableVertexAttribArray(bd->AttribLocationVtxClip));
+        GL_CALL(glVertexAttribIPointer(bd->AttribLocationVtxClip, 1, GL_UNSIGNED_SHORT, sizeof(ImU16), (GLvoid*)0));
+        GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, bd->VboHandle));
+    }
+#endif
+}
+
 static void ImGui_ImplOpenGL3_SetupRenderState(ImDrawData* draw_data, int fb_width, int fb_height, GLuint vertex_array_object)
 {
     ImGui_ImplOpenGL3_Data* bd = ImGui_ImplOpenGL3_GetBackendData();
@@ -400,7 +594,10 @@ static void ImGui_ImplOpenGL3_SetupRenderState(ImDrawData* draw_data, int fb_wid
     glDisable(GL_CULL_FACE);
     glDisable(GL_DEPTH_TEST);
     glDisable(GL_STENCIL_TEST);
-    glEnable(GL_SCISSOR_TEST);
+    if (bd->UseShaderClip)
+        glDisable(GL_SCISSOR_TEST);
+    else
+        glEnable(GL_SCISSOR_TEST);
 #ifdef IMGUI_IMPL_OPENGL_MAY_HAVE_PRIMITIVE_RESTART
     if (bd->GlVersion >= 310)
         glDisable(GL_PRIMITIVE_RESTART);
@@ -412,7 +609,7 @@ static void ImGui_ImplOpenGL3_SetupRenderState(ImDrawData* draw_data, int fb_wid
     // Support for GL 4.5 rarely used glClipControl(GL_UPPER_LEFT)
 #if defined(GL_CLIP_ORIGIN)
     bool clip_origin_lower_left = true;
-    if (bd->HasClipOrigin)
+    if (bd->HasClipOrigin && (bd->Flags & ImGui_ImplOpenGL3_Flags_AppOwnsState) == 0) // An application owning the state keeps the default lower left origin
     {
         GLenum current_clip_origin = 0; glGetIntegerv(GL_CLIP_ORIGIN, (GLint*)&current_clip_origin);
         if (current_clip_origin == GL_UPPER_LEFT)
@@ -446,21 +643,139 @@ static void ImGui_ImplOpenGL3_SetupRenderState(ImDrawData* draw_data, int fb_wid
         glBindSampler(0, 0); // We use combined texture/sampler state. Applications using GL 3.3 and GL ES 3.0 may set that otherwise.
 #endif
 
+    // The bound texture, scissor rectangle and clip rectangles are not known until the first command sets them
+    bd->HasShadowTexture = false;
+    bd->HasShadowScissor = false;
+    bd->ShadowClipWindow = -1;
+
     (void)vertex_array_object;
 #ifdef IMGUI_IMPL_OPENGL_USE_VERTEX_ARRAY
     glBindVertexArray(vertex_array_object);
 #endif
 
-    // Bind vertex/index buffers and setup attributes for ImDrawVert
+    // The persistent VAO already holds the index buffer and the attributes, only the vertex buffer binding is needed for uploads
+    if (bd->VaoHandle == 0 || vertex_array_object != bd->VaoHandle)
+        ImGui_ImplOpenGL3_SetupVertexAttribs();
+    else
+        GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, bd->VboHandle));
+}
+
+// Project a command's clip rectangle into framebuffer space, as glScissor() takes it (Y is inverted in OpenGL).
+// Returns false when nothing of the command can be visible.
+static bool ImGui_ImplOpenGL3_ProjectClipRect(const ImDrawData* draw_data, const ImDrawCmd* pcmd, int fb_height, GLint out_scissor[4])
+{
+    ImVec2 clip_off = draw_data->DisplayPos;         // (0,0) unless using multi-viewports
+    ImVec2 clip_scale = draw_data->FramebufferScale; // (1,1) unless using retina display which are often (2,2)
+    ImVec2 clip_min((pcmd->ClipRect.x - clip_off.x) * clip_scale.x, (pcmd->ClipRect.y - clip_off.y) * clip_scale.y);
+    ImVec2 clip_max((pcmd->ClipRect.z - clip_off.x) * clip_scale.x, (pcmd->ClipRect.w - clip_off.y) * clip_scale.y);
+    if (clip_max.x <= clip_min.x || clip_max.y <= clip_min.y)
+        return false;
+
+    out_scissor[0] = (GLint)clip_min.x;
+    out_scissor[1] = (GLint)((float)fb_height - clip_max.y);
+    out_scissor[2] = (GLint)(clip_max.x - clip_min.x);
+    out_scissor[3] = (GLint)(clip_max.y - clip_min.y);
+    return true;
+}
+
+// Bind the texture and the window of clip rectangles of a command (-1 when scissoring instead), unless already bound, and draw it
+static void ImGui_ImplOpenGL3_DrawCmd(const ImDrawCmd* pcmd, int clip_window, GLsizeiptr idx_buffer_start, int global_vtx_offset, int global_idx_offset)
+{
+    ImGui_ImplOpenGL3_Data* bd = ImGui_ImplOpenGL3_GetBackendData();
+#ifdef IMGUI_IMPL_OPENGL_MAY_HAVE_SHADER_CLIP
+    if (clip_window >= 0 && clip_window != bd->ShadowClipWindow)
+    {
+        const GLsizeiptr window_size = IMGUI_IMPL_OPENGL_CLIP_RECTS * 4 * (int)sizeof(float);
+        GL_CALL(glBindBufferRange(GL_UNIFORM_BUFFER, IMGUI_IMPL_OPENGL_CLIP_BINDING, bd->ClipRectsHandle, clip_window * window_size, window_size));
+        bd->ShadowClipWindow = clip_window;
+    }
+#else
+    IM_UNUSED(clip_window);
+#endif
+
+    const GLuint texture = (GLuint)(intptr_t)pcmd->GetTexID();
+    if (!bd->HasShadowTexture || texture != bd->ShadowTexture)
+    {
+        GL_CALL(glBindTexture(GL_TEXTURE_2D, texture));
+        bd->ShadowTexture = texture;
+        bd->HasShadowTexture = true;
+        bd->RenderStats.TextureBinds++;
+    }
+
+    const GLvoid* idx_offset = (const GLvoid*)(intptr_t)(idx_buffer_start + (GLsizeiptr)(pcmd->IdxOffset + global_idx_offset) * (int)sizeof(ImDrawIdx));
+#ifdef IMGUI_IMPL_OPENGL_MAY_HAVE_VTX_OFFSET
+    if (bd->GlVersion >= 320)
+        GL_CALL(glDrawElementsBaseVertex(GL_TRIANGLES, (GLsizei)pcmd->ElemCount, sizeof(ImDrawIdx) == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT, idx_offset, (GLint)(pcmd->VtxOffset + global_vtx_offset)));
+    else
+#endif
+    GL_CALL(glDrawElements(GL_TRIANGLES, (GLsizei)pcmd->ElemCount, sizeof(ImDrawIdx) == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT, idx_offset));
+    bd->RenderStats.DrawCalls++;
+}
+
+#ifdef IMGUI_IMPL_OPENGL_MAY_HAVE_SHADER_CLIP
+// Shader clipping: upload the clip rectangle of every command and, in a second vertex buffer, the rectangle's index for
+// every vertex of the command. The uniform block holds IMGUI_IMPL_OPENGL_CLIP_RECTS rectangles and is bound one such
+// window of the buffer at a time, a vertex has the index within its window. Consecutive commands with the same rectangle
+// share it. Commands are walked the same way RenderDrawData() does, bd->ClipWindows lists the window of each.
+static void ImGui_ImplOpenGL3_UploadClipRects(ImDrawData* draw_data, int fb_height)
+{
+    ImGui_ImplOpenGL3_Data* bd = ImGui_ImplOpenGL3_GetBackendData();
+    bd->ClipIndices.resize(draw_data->TotalVtxCount);
+    bd->ClipRects.resize(0);
+    bd->ClipWindows.resize(0);
+
+    GLint last_scissor[4] = { 0, 0, 0, 0 };
+    int global_vtx_offset = 0;
+    for (int n = 0; n < draw_data->CmdListsCount; n++)
+    {
+        const ImDrawList* cmd_list = draw_data->CmdLists[n];
+        for (int cmd_i = 0; cmd_i < cmd_list->CmdBuffer.Size; cmd_i++)
+        {
+            const ImDrawCmd* pcmd = &cmd_list->CmdBuffer[cmd_i];
+            GLint scissor[4];
+            if (pcmd->UserCallback != nullptr || !ImGui_ImplOpenGL3_ProjectClipRect(draw_data, pcmd, fb_height, scissor))
+                continue;
+
+            // Stored as min/max corners, the fragment shader keeps what glScissor() would have
+            if (bd->ClipRects.Size == 0 || memcmp(scissor, last_scissor, sizeof(scissor)) != 0)
+            {
+                const float rect[4] = { (float)scissor[0], (float)scissor[1], (float)(scissor[0] + scissor[2]), (float)(scissor[1] + scissor[3]) };
+                bd->ClipRects.push_back(rect[0]);
+                bd->ClipRects.push_back(rect[1]);
+                bd->ClipRects.push_back(rect[2]);
+                bd->ClipRects.push_back(rect[3]);
+                memcpy(last_scissor, scissor, sizeof(scissor));
+            }
+            const int rect_n = bd->ClipRects.Size / 4 - 1;
+            bd->ClipWindows.push_back(rect_n / IMGUI_IMPL_OPENGL_CLIP_RECTS);
+
+            const ImU16 clip_index = (ImU16)(rect_n % IMGUI_IMPL_OPENGL_CLIP_RECTS);
+            ImU16* clip_dst = bd->ClipIndices.Data + global_vtx_offset + pcmd->VtxOffset;
+            const ImDrawIdx* idx_src = cmd_list->IdxBuffer.Data + pcmd->IdxOffset;
+            for (unsigned int i = 0; i < pcmd->ElemCount; i++)
+                clip_dst[idx_src[i]] = clip_index;
+        }
+        global_vtx_offset += cmd_list->VtxBuffer.Size;
+    }
+
+    // The last window is filled up, a bound range must cover the whole uniform block
+    const int windows_n = (bd->ClipRects.Size / 4 + IMGUI_IMPL_OPENGL_CLIP_RECTS - 1) / IMGUI_IMPL_OPENGL_CLIP_RECTS;
+    bd->ClipRects.resize((windows_n > 0 ? windows_n : 1) * IMGUI_IMPL_OPENGL_CLIP_RECTS * 4, 0.0f);
+
+    const GLsizeiptr clip_indices_size = (GLsizeiptr)bd->ClipIndices.Size * (int)sizeof(ImU16);
+    const GLsizeiptr clip_rects_size = (GLsizeiptr)bd->ClipRects.Size * (int)sizeof(float);
+    GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, bd->ClipIndexHandle));
+    GL_CALL(glBufferData(GL_ARRAY_BUFFER, clip_indices_size, (const GLvoid*)bd->ClipIndices.Data, GL_STREAM_DRAW));
     GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, bd->VboHandle));
-    GL_CALL(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, bd->ElementsHandle));
-    GL_CALL(glEnableVertexAttribArray(bd->AttribLocationVtxPos));
-    GL_CALL(glEnableVertexAttribArray(bd->AttribLocationVtxUV));
-    GL_CALL(glEnableVertexAttribArray(bd->AttribLocationVtxColor));
-    GL_CALL(glVertexAttribPointer(bd->AttribLocationVtxPos,   2, GL_FLOAT,         GL_FALSE, sizeof(ImDrawVert), (GLvoid*)IM_OFFSETOF(ImDrawVert, pos)));
-    GL_CALL(glVertexAttribPointer(bd->AttribLocationVtxUV,    2, GL_FLOAT,         GL_FALSE, sizeof(ImDrawVert), (GLvoid*)IM_OFFSETOF(ImDrawVert, uv)));
-    GL_CALL(glVertexAttribPointer(bd->AttribLocationVtxColor, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(ImDrawVert), (GLvoid*)IM_OFFSETOF(ImDrawVert, col)));
+    GL_CALL(glBindBuffer(GL_UNIFORM_BUFFER, bd->ClipRectsHandle));
+    GL_CALL(glBufferData(GL_UNIFORM_BUFFER, clip_rects_size, (const GLvoid*)bd->ClipRects.Data, GL_STREAM_DRAW));
+    GL_CALL(glBindBuffer(GL_UNIFORM_BUFFER, 0));
+    bd->RenderStats.BytesUploaded += (size_t)(clip_indices_size + clip_rects_size);
+
+    // The buffer may have shrunk, its range is bound again
+    bd->ShadowClipWindow = -1;
 }
+#endif
 
 // OpenGL3 Render function.
 // Note that this implementation is little overcomplicated because we are saving/setting up/restoring every OpenGL state explicitly.
@@ -470,64 +785,64 @@ void    ImGui_ImplOpenGL3_RenderDrawData(ImDrawData* draw_data)
     // Avoid rendering when minimized, scale coordinates for retina displays (screen coordinates != framebuffer coordinates)
     int fb_width = (int)(draw_data->DisplaySize.x * draw_data->FramebufferScale.x);
     int fb_height = (int)(draw_data->DisplaySize.y * draw_data->FramebufferScale.y);
+    ImGui_ImplOpenGL3_Data* bd = ImGui_ImplOpenGL3_GetBackendData();
+    memset(&bd->RenderStats, 0, sizeof(bd->RenderStats));
     if (fb_width <= 0 || fb_height <= 0)
         return;
 
-    ImGui_ImplOpenGL3_Data* bd = ImGui_ImplOpenGL3_GetBackendData();
-
     // Backup GL state
-    GLenum last_active_texture; glGetIntegerv(GL_ACTIVE_TEXTURE, (GLint*)&last_active_texture);
-    glActiveTexture(GL_TEXTURE0);
-    GLuint last_program; glGetIntegerv(GL_CURRENT_PROGRAM, (GLint*)&last_program);
-    GLuint last_texture; glGetIntegerv(GL_TEXTURE_BINDING_2D, (GLint*)&last_texture);
-#ifdef IMGUI_IMPL_OPENGL_MAY_HAVE_BIND_SAMPLER
-    GLuint last_sampler; if (bd->GlVersion >= 330 || bd->GlProfileIsES3) { glGetIntegerv(GL_SAMPLER_BINDING, (GLint*)&last_sampler); } else { last_sampler = 0; }
-#endif
-    GLuint last_array_buffer; glGetIntegerv(GL_ARRAY_BUFFER_BINDING, (GLint*)&last_array_buffer);
-#ifndef IMGUI_IMPL_OPENGL_USE_VERTEX_ARRAY
-    // This is part of VAO on OpenGL 3.0+ and OpenGL ES 3.0+.
-    GLint last_element_array_buffer; glGetIntegerv(GL_ELEMENT_ARRAY_BUFFER_BINDING, &last_element_array_buffer);
-    ImGui_ImplOpenGL3_VtxAttribState last_vtx_attrib_state_pos; last_vtx_attrib_state_pos.GetState(bd->AttribLocationVtxPos);
-    ImGui_ImplOpenGL3_VtxAttribState last_vtx_attrib_state_uv; last_vtx_attrib_state_uv.GetState(bd->AttribLocationVtxUV);
-    ImGui_ImplOpenGL3_VtxAttribState last_vtx_attrib_state_color; last_vtx_attrib_state_color.GetState(bd->AttribLocationVtxColor);
-#endif
-#ifdef IMGUI_IMPL_OPENGL_USE_VERTEX_ARRAY
-    GLuint last_vertex_array_object; glGetIntegerv(GL_VERTEX_ARRAY_BINDING, (GLint*)&last_vertex_array_object);
-#endif
-#ifdef IMGUI_IMPL_HAS_POLYGON_MODE
-    GLint last_polygon_mode[2]; glGetIntegerv(GL_POLYGON_MODE, last_polygon_mode);
-#endif
-    GLint last_viewport[4]; glGetIntegerv(GL_VIEWPORT, last_viewport);
-    GLint last_scissor_box[4]; glGetIntegerv(GL_SCISSOR_BOX, last_scissor_box);
-    GLenum last_blend_src_rgb; glGetIntegerv(GL_BLEND_SRC_RGB, (GLint*)&last_blend_src_rgb);
-    GLenum last_blend_dst_rgb; glGetIntegerv(GL_BLEND_DST_RGB, (GLint*)&last_blend_dst_rgb);
-    GLenum last_blend_src_alpha; glGetIntegerv(GL_BLEND_SRC_ALPHA, (GLint*)&last_blend_src_alpha);
-    GLenum last_blend_dst_alpha; glGetIntegerv(GL_BLEND_DST_ALPHA, (GLint*)&last_blend_dst_alpha);
-    GLenum last_blend_equation_rgb; glGetIntegerv(GL_BLEND_EQUATION_RGB, (GLint*)&last_blend_equation_rgb);
-    GLenum last_blend_equation_alpha; glGetIntegerv(GL_BLEND_EQUATION_ALPHA, (GLint*)&last_blend_equation_alpha);
-    GLboolean last_enable_blend = glIsEnabled(GL_BLEND);
-    GLboolean last_enable_cull_face = glIsEnabled(GL_CULL_FACE);
-    GLboolean last_enable_depth_test = glIsEnabled(GL_DEPTH_TEST);
-    GLboolean last_enable_stencil_test = glIsEnabled(GL_STENCIL_TEST);
-    GLboolean last_enable_scissor_test = glIsEnabled(GL_SCISSOR_TEST);
-#ifdef IMGUI_IMPL_OPENGL_MAY_HAVE_PRIMITIVE_RESTART
-    GLboolean last_enable_primitive_restart = (bd->GlVersion >= 310) ? glIsEnabled(GL_PRIMITIVE_RESTART) : GL_FALSE;
-#endif
+    // With ImGui_ImplOpenGL3_Flags_AppOwnsState nothing is queried or restored, the state below is set regardless.
+    const bool backup_state = (bd->Flags & ImGui_ImplOpenGL3_Flags_AppOwnsState) == 0;
+    ImGui_ImplOpenGL3_StateBackup backup;
+    if (backup_state)
+        backup.Backup(); // Selects GL_TEXTURE0 as well
+    else
+        glActiveTexture(GL_TEXTURE0);
 
     // Setup desired GL state
-    // Recreate the VAO every time (this is to easily allow multiple GL contexts to be rendered to. VAO are not shared among GL contexts)
+    // Use the VAO kept in the backend data. It only exists in the GL context that created the device objects, so with
+    // ImGui_ImplOpenGL3_Flags_MultipleContexts recreate it every time instead (VAO are not shared among GL contexts).
     // The renderer would actually work without any VAO bound, but then our VertexAttrib calls would overwrite the default one currently bound.
-    GLuint vertex_array_object = 0;
+    GLuint vertex_array_object = bd->VaoHandle;
 #ifdef IMGUI_IMPL_OPENGL_USE_VERTEX_ARRAY
-    GL_CALL(glGenVertexArrays(1, &vertex_array_object));
+    if (vertex_array_object == 0)
+        GL_CALL(glGenVertexArrays(1, &vertex_array_object));
 #endif
     ImGui_ImplOpenGL3_SetupRenderState(draw_data, fb_width, fb_height, vertex_array_object);
 
-    // Will project scissor/clipping rectangles into framebuffer space
-    ImVec2 clip_off = draw_data->DisplayPos;         // (0,0) unless using multi-viewports
-    ImVec2 clip_scale = draw_data->FramebufferScale; // (1,1) unless using retina display which are often (2,2)
+    // Upload all vertex/index buffers at once
+    // - Every draw list is copied into one staging buffer, all the vertices followed by all the indices, and uploaded
+    //   with a single glBufferData() which orphans last frame's storage. The same buffer is bound as the index buffer.
+    // - Each draw list is then drawn from its own offsets, the vertices with the base vertex of glDrawElementsBaseVertex().
+    GLsizeiptr idx_buffer_start = 0;
+    if (bd->UseSingleUpload)
+    {
+        const GLsizeiptr vtx_total_size = (GLsizeiptr)draw_data->TotalVtxCount * (int)sizeof(ImDrawVert);
+        const GLsizeiptr idx_total_size = (GLsizeiptr)draw_data->TotalIdxCount * (int)sizeof(ImDrawIdx);
+        bd->UploadBuffer.resize((int)(vtx_total_size + idx_total_size));
+        char* vtx_dst = bd->UploadBuffer.Data;
+        char* idx_dst = bd->UploadBuffer.Data + vtx_total_size;
+        for (int n = 0; n < draw_data->CmdListsCount; n++)
+        {
+            const ImDrawList* cmd_list = draw_data->CmdLists[n];
+            memcpy(vtx_dst, cmd_list->VtxBuffer.Data, (size_t)cmd_list->VtxBuffer.Size * sizeof(ImDrawVert));
+            memcpy(idx_dst, cmd_list->IdxBuffer.Data, (size_t)cmd_list->IdxBuffer.Size * sizeof(ImDrawIdx));
+            vtx_dst += cmd_list->VtxBuffer.Size * sizeof(ImDrawVert);
+            idx_dst += cmd_list->IdxBuffer.Size * sizeof(ImDrawIdx);
+        }
+        GL_CALL(glBufferData(GL_ARRAY_BUFFER, vtx_total_size + idx_total_size, (const GLvoid*)bd->UploadBuffer.Data, GL_STREAM_DRAW));
+        bd->RenderStats.BytesUploaded += (size_t)(vtx_total_size + idx_total_size);
+        idx_buffer_start = vtx_total_size;
+    }
+#ifdef IMGUI_IMPL_OPENGL_MAY_HAVE_SHADER_CLIP
+    if (bd->UseShaderClip)
+        ImGui_ImplOpenGL3_UploadClipRects(draw_data, fb_height);
+#endif
 
     // Render command lists
+    int global_vtx_offset = 0;
+    int global_idx_offset = 0;
+    int clip_cmd_n = 0;
     for (int n = 0; n < draw_data->CmdListsCount; n++)
     {
         const ImDrawList* cmd_list = draw_data->CmdLists[n];
@@ -542,7 +857,11 @@ void    ImGui_ImplOpenGL3_RenderDrawData(ImDrawData* draw_data)
         // - See https://github.com/ocornut/imgui/issues/4468 and please report any corruption issues.
         const GLsizeiptr vtx_buffer_size = (GLsizeiptr)cmd_list->VtxBuffer.Size * (int)sizeof(ImDrawVert);
         const GLsizeiptr idx_buffer_size = (GLsizeiptr)cmd_list->IdxBuffer.Size * (int)sizeof(ImDrawIdx);
-        if (bd->UseBufferSubData)
+        if (bd->UseSingleUpload)
+        {
+            // Uploaded along with every other draw list above
+        }
+        else if (bd->UseBufferSubData)
         {
             if (bd->VertexBufferSize < vtx_buffer_size)
             {
@@ -556,101 +875,108 @@ void    ImGui_ImplOpenGL3_RenderDrawData(ImDrawData* draw_data)
             }
             GL_CALL(glBufferSubData(GL_ARRAY_BUFFER, 0, vtx_buffer_size, (const GLvoid*)cmd_list->VtxBuffer.Data));
             GL_CALL(glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, idx_buffer_size, (const GLvoid*)cmd_list->IdxBuffer.Data));
+            bd->RenderStats.BytesUploaded += (size_t)(vtx_buffer_size + idx_buffer_size);
         }
         else
         {
             GL_CALL(glBufferData(GL_ARRAY_BUFFER, vtx_buffer_size, (const GLvoid*)cmd_list->VtxBuffer.Data, GL_STREAM_DRAW));
             GL_CALL(glBufferData(GL_ELEMENT_ARRAY_BUFFER, idx_buffer_size, (const GLvoid*)cmd_list->IdxBuffer.Data, GL_STREAM_DRAW));
+            bd->RenderStats.BytesUploaded += (size_t)(vtx_buffer_size + idx_buffer_size);
         }
 
+        // With shader clipping, consecutive commands drawing the same texture from contiguous indices are merged into
+        // "batch" and drawn at once (the clip rectangle index comes with every vertex), drawn when the next one can't join.
+        // (global offsets are 0 unless all draw lists were uploaded at once, which implies glDrawElementsBaseVertex() is available)
+        ImDrawCmd batch;
+        batch.ElemCount = 0;
+        int batch_clip_window = 0;
         for (int cmd_i = 0; cmd_i < cmd_list->CmdBuffer.Size; cmd_i++)
         {
             const ImDrawCmd* pcmd = &cmd_list->CmdBuffer[cmd_i];
             if (pcmd->UserCallback != nullptr)
             {
+                if (batch.ElemCount > 0)
+                {
+                    ImGui_ImplOpenGL3_DrawCmd(&batch, batch_clip_window, idx_buffer_start, global_vtx_offset, global_idx_offset);
+                    batch.ElemCount = 0;
+                }
+
                 // User callback, registered via ImDrawList::AddCallback()
                 // (ImDrawCallback_ResetRenderState is a special callback value used by the user to request the renderer to reset render state.)
                 if (pcmd->UserCallback == ImDrawCallback_ResetRenderState)
                     ImGui_ImplOpenGL3_SetupRenderState(draw_data, fb_width, fb_height, vertex_array_object);
                 else
                     pcmd->UserCallback(cmd_list, pcmd);
+
+                // The callback may have bound anything
+                bd->HasShadowTexture = false;
+                bd->HasShadowScissor = false;
+                bd->ShadowClipWindow = -1;
+                continue;
             }
-            else
+
+            // Project scissor/clipping rectangles into framebuffer space
+            GLint scissor[4];
+            if (!ImGui_ImplOpenGL3_ProjectClipRect(draw_data, pcmd, fb_height, scissor))
+                continue;
+
+            if (bd->UseShaderClip)
             {
-                // Project scissor/clipping rectangles into framebuffer space
-                ImVec2 clip_min((pcmd->ClipRect.x - clip_off.x) * clip_scale.x, (pcmd->ClipRect.y - clip_off.y) * clip_scale.y);
-                ImVec2 clip_max((pcmd->ClipRect.z - clip_off.x) * clip_scale.x, (pcmd->ClipRect.w - clip_off.y) * clip_scale.y);
-                if (clip_max.x <= clip_min.x || clip_max.y <= clip_min.y)
+                const int clip_window = bd->ClipWindows[clip_cmd_n++];
+                if (batch.ElemCount > 0 && batch.GetTexID() == pcmd->GetTexID() && batch.VtxOffset == pcmd->VtxOffset &&
+                    batch.IdxOffset + batch.ElemCount == pcmd->IdxOffset && batch_clip_window == clip_window)
+                {
+                    batch.ElemCount += pcmd->ElemCount;
                     continue;
+                }
+                if (batch.ElemCount > 0)
+                    ImGui_ImplOpenGL3_DrawCmd(&batch, batch_clip_window, idx_buffer_start, global_vtx_offset, global_idx_offset);
+                batch = *pcmd;
+                batch_clip_window = clip_window;
+                continue;
+            }
 
-                // Apply scissor/clipping rectangle (Y is inverted in OpenGL)
-                GL_CALL(glScissor((int)clip_min.x, (int)((float)fb_height - clip_max.y), (int)(clip_max.x - clip_min.x), (int)(clip_max.y - clip_min.y)));
-
-                // Bind texture, Draw
-                GL_CALL(glBindTexture(GL_TEXTURE_2D, (GLuint)(intptr_t)pcmd->GetTexID()));
-#ifdef IMGUI_IMPL_OPENGL_MAY_HAVE_VTX_OFFSET
-                if (bd->GlVersion >= 320)
-                    GL_CALL(glDrawElementsBaseVertex(GL_TRIANGLES, (GLsizei)pcmd->ElemCount, sizeof(ImDrawIdx) == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT, (void*)(intptr_t)(pcmd->IdxOffset * sizeof(ImDrawIdx)), (GLint)pcmd->VtxOffset));
-                else
-#endif
-                GL_CALL(glDrawElements(GL_TRIANGLES, (GLsizei)pcmd->ElemCount, sizeof(ImDrawIdx) == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT, (void*)(intptr_t)(pcmd->IdxOffset * sizeof(ImDrawIdx))));
+            // Apply scissor/clipping rectangle, unless the previous command already did
+            if (!bd->HasShadowScissor || memcmp(scissor, bd->ShadowScissor, sizeof(scissor)) != 0)
+            {
+                GL_CALL(glScissor(scissor[0], scissor[1], scissor[2], scissor[3]));
+                memcpy(bd->ShadowScissor, scissor, sizeof(scissor));
+                bd->HasShadowScissor = true;
+                bd->RenderStats.ScissorChanges++;
             }
+
+            // Bind texture, Draw
+            ImGui_ImplOpenGL3_DrawCmd(pcmd, -1, idx_buffer_start, global_vtx_offset, global_idx_offset);
+        }
+        if (batch.ElemCount > 0)
+            ImGui_ImplOpenGL3_DrawCmd(&batch, batch_clip_window, idx_buffer_start, global_vtx_offset, global_idx_offset);
+
+        if (bd->UseSingleUpload)
+        {
+            global_vtx_offset += cmd_list->VtxBuffer.Size;
+            global_idx_offset += cmd_list->IdxBuffer.Size;
         }
     }
 
     // Destroy the temporary VAO
 #ifdef IMGUI_IMPL_OPENGL_USE_VERTEX_ARRAY
-    GL_CALL(glDeleteVertexArrays(1, &vertex_array_object));
+    if (vertex_array_object != bd->VaoHandle)
+        GL_CALL(glDeleteVertexArrays(1, &vertex_array_object));
 #endif
 
     // Restore modified GL state
-    // This "glIsProgram()" check is required because if the program is "pending deletion" at the time of binding backup, it will have been deleted by now and will cause an OpenGL error. See #6220.
-    if (last_program == 0 || glIsProgram(last_program)) glUseProgram(last_program);
-    glBindTexture(GL_TEXTURE_2D, last_texture);
-#ifdef IMGUI_IMPL_OPENGL_MAY_HAVE_BIND_SAMPLER
-    if (bd->GlVersion >= 330 || bd->GlProfileIsES3)
-        glBindSampler(0, last_sampler);
-#endif
-    glActiveTexture(last_active_texture);
-#ifdef IMGUI_IMPL_OPENGL_USE_VERTEX_ARRAY
-    glBindVertexArray(last_vertex_array_object);
-#endif
-    glBindBuffer(GL_ARRAY_BUFFER, last_array_buffer);
-#ifndef IMGUI_IMPL_OPENGL_USE_VERTEX_ARRAY
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, last_element_array_buffer);
-    last_vtx_attrib_state_pos.SetState(bd->AttribLocationVtxPos);
-    last_vtx_attrib_state_uv.SetState(bd->AttribLocationVtxUV);
-    last_vtx_attrib_state_color.SetState(bd->AttribLocationVtxColor);
-#endif
-    glBlendEquationSeparate(last_blend_equation_rgb, last_blend_equation_alpha);
-    glBlendFuncSeparate(last_blend_src_rgb, last_blend_dst_rgb, last_blend_src_alpha, last_blend_dst_alpha);
-    if (last_enable_blend) glEnable(GL_BLEND); else glDisable(GL_BLEND);
-    if (last_enable_cull_face) glEnable(GL_CULL_FACE); else glDisable(GL_CULL_FACE);
-    if (last_enable_depth_test) glEnable(GL_DEPTH_TEST); else glDisable(GL_DEPTH_TEST);
-    if (last_enable_stencil_test) glEnable(GL_STENCIL_TEST); else glDisable(GL_STENCIL_TEST);
-    if (last_enable_scissor_test) glEnable(GL_SCISSOR_TEST); else glDisable(GL_SCISSOR_TEST);
-#ifdef IMGUI_IMPL_OPENGL_MAY_HAVE_PRIMITIVE_RESTART
-    if (bd->GlVersion >= 310) { if (last_enable_primitive_restart) glEnable(GL_PRIMITIVE_RESTART); else glDisable(GL_PRIMITIVE_RESTART); }
-#endif
-
-#ifdef IMGUI_IMPL_HAS_POLYGON_MODE
-    // Desktop OpenGL 3.0 and OpenGL 3.1 had separate polygon draw modes for front-facing and back-facing faces of polygons
-    if (bd->GlVersion <= 310 || bd->GlProfileIsCompat)
-    {
-        glPolygonMode(GL_FRONT, (GLenum)last_polygon_mode[0]);
-        glPolygonMode(GL_BACK, (GLenum)last_polygon_mode[1]);
-    }
-    else
-    {
-        glPolygonMode(GL_FRONT_AND_BACK, (GLenum)last_polygon_mode[0]);
-    }
-#endif // IMGUI_IMPL_HAS_POLYGON_MODE
-
-    glViewport(last_viewport[0], last_viewport[1], (GLsizei)last_viewport[2], (GLsizei)last_viewport[3]);
-    glScissor(last_scissor_box[0], last_scissor_box[1], (GLsizei)last_scissor_box[2], (GLsizei)last_scissor_box[3]);
+    if (backup_state)
+        backup.Restore();
     (void)bd; // Not all compilation paths use this
 }
 
+ImGui_ImplOpenGL3_RenderStats ImGui_ImplOpenGL3_GetRenderStats()
+{
+    ImGui_ImplOpenGL3_Data* bd = ImGui_ImplOpenGL3_GetBackendData();
+    IM_ASSERT(bd != nullptr && "Did you call ImGui_ImplOpenGL3_Init()?");
+    return bd->RenderStats;
+}
+
 bool ImGui_ImplOpenGL3_CreateFontsTexture()
 {
     ImGuiIO& io = ImGui::GetIO();
@@ -850,10 +1176,51 @@ bool    ImGui_ImplOpenGL3_CreateDeviceObjects()
         "    Out_Color = Frag_Color * texture(Texture, Frag_UV.st);\n"
         "}\n";
 
+    // Shader clipping (GLSL 330+): every vertex has the index of its clip rectangle, the fragment shader keeps what glScissor() would
+    // (Rects[] holds IMGUI_IMPL_OPENGL_CLIP_RECTS rectangles)
+    const GLchar* vertex_shader_glsl_330_clip =
+        "layout (location = 0) in vec2 Position;\n"
+        "layout (location = 1) in vec2 UV;\n"
+        "layout (location = 2) in vec4 Color;\n"
+        "layout (location = 3) in uint ClipIndex;\n"
+        "uniform mat4 ProjMtx;\n"
+        "layout (std140) uniform ClipRects\n"
+        "{\n"
+        "    vec4 Rects[1024];\n"
+        "};\n"
+        "out vec2 Frag_UV;\n"
+        "out vec4 Frag_Color;\n"
+        "flat out vec4 Frag_ClipRect;\n"
+        "void main()\n"
+        "{\n"
+        "    Frag_UV = UV;\n"
+        "    Frag_Color = Color;\n"
+        "    Frag_ClipRect = Rects[ClipIndex];\n"
+        "    gl_Position = ProjMtx * vec4(Position.xy,0,1);\n"
+        "}\n";
+
+    const GLchar* fragment_shader_glsl_330_clip =
+        "in vec2 Frag_UV;\n"
+        "in vec4 Frag_Color;\n"
+        "flat in vec4 Frag_ClipRect;\n"
+        "uniform sampler2D Texture;\n"
+        "layout (location = 0) out vec4 Out_Color;\n"
+        "void main()\n"
+        "{\n"
+        "    if (any(lessThan(gl_FragCoord.xy, Frag_ClipRect.xy)) || any(greaterThanEqual(gl_FragCoord.xy, Frag_ClipRect.zw)))\n"
+        "        discard;\n"
+        "    Out_Color = Frag_Color * texture(Texture, Frag_UV.st);\n"
+        "}\n";
+
     // Select shaders matching our GLSL versions
     const GLchar* vertex_shader = nullptr;
     const GLchar* fragment_shader = nullptr;
-    if (glsl_version < 130)
+    if (bd->UseShaderClip)
+    {
+        vertex_shader = vertex_shader_glsl_330_clip;
+        fragment_shader = fragment_shader_glsl_330_clip;
+    }
+    else if (glsl_version < 130)
     {
         vertex_shader = vertex_shader_glsl_120;
         fragment_shader = fragment_shader_glsl_120;
@@ -908,6 +1275,27 @@ bool    ImGui_ImplOpenGL3_CreateDeviceObjects()
     // Create buffers
     glGenBuffers(1, &bd->VboHandle);
     glGenBuffers(1, &bd->ElementsHandle);
+#ifdef IMGUI_IMPL_OPENGL_MAY_HAVE_SHADER_CLIP
+    if (bd->UseShaderClip)
+    {
+        bd->AttribLocationVtxClip = (GLuint)glGetAttribLocation(bd->ShaderHandle, "ClipIndex");
+        GLuint clip_rects_block = glGetUniformBlockIndex(bd->ShaderHandle, "ClipRects");
+        if (clip_rects_block != GL_INVALID_INDEX)
+            glUniformBlockBinding(bd->ShaderHandle, clip_rects_block, IMGUI_IMPL_OPENGL_CLIP_BINDING);
+        glGenBuffers(1, &bd->ClipIndexHandle);
+        glGenBuffers(1, &bd->ClipRectsHandle);
+    }
+#endif
+
+    // Create the VAO, its attributes are set up once here (unless rendering from several GL contexts)
+#ifdef IMGUI_IMPL_OPENGL_USE_VERTEX_ARRAY
+    if ((bd->Flags & ImGui_ImplOpenGL3_Flags_MultipleContexts) == 0)
+    {
+        glGenVertexArrays(1, &bd->VaoHandle);
+        glBindVertexArray(bd->VaoHandle);
+        ImGui_ImplOpenGL3_SetupVertexAttribs();
+    }
+#endif
 
     ImGui_ImplOpenGL3_CreateFontsTexture();
 
@@ -926,7 +1314,16 @@ void    ImGui_ImplOpenGL3_DestroyDeviceObjects()
     ImGui_ImplOpenGL3_Data* bd = ImGui_ImplOpenGL3_GetBackendData();
     if (bd->VboHandle)      { glDeleteBuffers(1, &bd->VboHandle); bd->VboHandle = 0; }
     if (bd->ElementsHandle) { glDeleteBuffers(1, &bd->ElementsHandle); bd->ElementsHandle = 0; }
+    if (bd->ClipIndexHandle) { glDeleteBuffers(1, &bd->ClipIndexHandle); bd->ClipIndexHandle = 0; }
+    if (bd->ClipRectsHandle) { glDeleteBuffers(1, &bd->ClipRectsHandle); bd->ClipRectsHandle = 0; }
+#ifdef IMGUI_IMPL_OPENGL_USE_VERTEX_ARRAY
+    if (bd->VaoHandle)      { glDeleteVertexArrays(1, &bd->VaoHandle); bd->VaoHandle = 0; }
+#endif
     if (bd->ShaderHandle)   { glDeleteProgram(bd->ShaderHandle); bd->ShaderHandle = 0; }
+    bd->UploadBuffer.clear();
+    bd->ClipIndices.clear();
+    bd->ClipRects.clear();
+    bd->ClipWindows.clear();
     ImGui_ImplOpenGL3_DestroyFontsTexture();
 }
 
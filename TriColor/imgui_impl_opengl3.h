@@ -26,11 +26,32 @@
 #include "imgui.h"      // IMGUI_IMPL_API
 #ifndef IMGUI_DISABLE
 
+// Flags for ImGui_ImplOpenGL3_Init()
+enum ImGui_ImplOpenGL3_Flags_
+{
+    ImGui_ImplOpenGL3_Flags_None                = 0,
+    ImGui_ImplOpenGL3_Flags_MultipleContexts    = 1 << 0,   // Render from more than one GL context: recreate the VAO every frame instead of keeping one in the backend data (VAO are not shared among GL contexts).
+    ImGui_ImplOpenGL3_Flags_SingleUpload        = 1 << 1,   // Upload the vertices and indices of all draw lists as one buffer per frame instead of two buffers per draw list. Needs glDrawElementsBaseVertex() (GL 3.2+), ignored otherwise.
+    ImGui_ImplOpenGL3_Flags_AppOwnsState        = 1 << 2,   // Don't query GL state before rendering or restore it after. The state rendering needs is still set, and left set: the application sets its own again before drawing, and keeps the default GL_LOWER_LEFT clip origin.
+    ImGui_ImplOpenGL3_Flags_ShaderClip          = 1 << 3,   // Clip in the fragment shader against rectangles in a uniform buffer (binding point 0) instead of with glScissor(), so consecutive commands using the same texture are drawn at once. Implies ImGui_ImplOpenGL3_Flags_SingleUpload, needs desktop GL 3.2 and GLSL 330+, ignored otherwise.
+};
+typedef int ImGui_ImplOpenGL3_Flags;    // -> enum ImGui_ImplOpenGL3_Flags_
+
+// Counters of the last ImGui_ImplOpenGL3_RenderDrawData() call
+struct ImGui_ImplOpenGL3_RenderStats
+{
+    int     DrawCalls;
+    int     TextureBinds;       // glBindTexture() calls, skipped when a command uses the texture already bound
+    int     ScissorChanges;     // glScissor() calls, skipped when a command has the same clip rectangle as the one before
+    size_t  BytesUploaded;      // Vertex and index data
+};
+
 // Backend API
-IMGUI_IMPL_API bool     ImGui_ImplOpenGL3_Init(const char* glsl_version = nullptr);
+IMGUI_IMPL_API bool     ImGui_ImplOpenGL3_Init(const char* glsl_version = nullptr, ImGui_ImplOpenGL3_Flags flags = ImGui_ImplOpenGL3_Flags_None);
 IMGUI_IMPL_API void     ImGui_ImplOpenGL3_Shutdown();
 IMGUI_IMPL_API void     ImGui_ImplOpenGL3_NewFrame();
 IMGUI_IMPL_API void     ImGui_ImplOpenGL3_RenderDrawData(ImDrawData* draw_data);
+IMGUI_IMPL_API ImGui_ImplOpenGL3_RenderStats ImGui_ImplOpenGL3_GetRenderStats();
 
 // (Optional) Called by Init/NewFrame/Shutdown
 IMGUI_IMPL_API bool     ImGui_ImplOpenGL3_CreateFontsTexture();
@@ -355,11 +355,15 @@ typedef khronos_uint16_t GLhalf;
 #define GL_VERTEX_ARRAY_BINDING           0x85B5
 typedef void (APIENTRYP PFNGLGETBOOLEANI_VPROC) (GLenum target, GLuint index, GLboolean *data);
 typedef void (APIENTRYP PFNGLGETINTEGERI_VPROC) (GLenum target, GLuint index, GLint *data);
+typedef void (APIENTRYP PFNGLBINDBUFFERRANGEPROC) (GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size);
+typedef void (APIENTRYP PFNGLVERTEXATTRIBIPOINTERPROC) (GLuint index, GLint size, GLenum type, GLsizei stride, const void *pointer);
 typedef const GLubyte *(APIENTRYP PFNGLGETSTRINGIPROC) (GLenum name, GLuint index);
 typedef void (APIENTRYP PFNGLBINDVERTEXARRAYPROC) (GLuint array);
 typedef void (APIENTRYP PFNGLDELETEVERTEXARRAYSPROC) (GLsizei n, const GLuint *arrays);
 typedef void (APIENTRYP PFNGLGENVERTEXARRAYSPROC) (GLsizei n, GLuint *arrays);
 #ifdef GL_GLEXT_PROTOTYPES
+GLAPI void APIENTRY glBindBufferRange (GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size);
+GLAPI void APIENTRY glVertexAttribIPointer (GLuint index, GLint size, GLenum type, GLsizei stride, const void *pointer);
 GLAPI const GLubyte *APIENTRY glGetStringi (GLenum name, GLuint index);
 GLAPI void APIENTRY glBindVertexArray (GLuint array);
 GLAPI void APIENTRY glDeleteVertexArrays (GLsizei n, const GLuint *arrays);
@@ -369,6 +373,14 @@ GLAPI void APIENTRY glGenVertexArrays (GLsizei n, GLuint *arrays);
 #ifndef GL_VERSION_3_1
 #define GL_VERSION_3_1 1
 #define GL_PRIMITIVE_RESTART              0x8F9D
+#define GL_UNIFORM_BUFFER                 0x8A11
+#define GL_INVALID_INDEX                  0xFFFFFFFFu
+typedef GLuint (APIENTRYP PFNGLGETUNIFORMBLOCKINDEXPROC) (GLuint program, const GLchar *uniformBlockName);
+typedef void (APIENTRYP PFNGLUNIFORMBLOCKBINDINGPROC) (GLuint program, GLuint uniformBlockIndex, GLuint uniformBlockBinding);
+#ifdef GL_GLEXT_PROTOTYPES
+GLAPI GLuint APIENTRY glGetUniformBlockIndex (GLuint program, const GLchar *uniformBlockName);
+GLAPI void APIENTRY glUniformBlockBinding (GLuint program, GLuint uniformBlockIndex, GLuint uniformBlockBinding);
+#endif
 #endif /* GL_VERSION_3_1 */
 #ifndef GL_VERSION_3_2
 #define GL_VERSION_3_2 1
@@ -468,11 +480,12 @@ GL3W_API GL3WglProc imgl3wGetProcAddress(const char *proc);
 
 /* gl3w internal state */
 union GL3WProcs {
-    GL3WglProc ptr[59];
+    GL3WglProc ptr[63];
     struct {
         PFNGLACTIVETEXTUREPROC            ActiveTexture;
         PFNGLATTACHSHADERPROC             AttachShader;
         PFNGLBINDBUFFERPROC               BindBuffer;
+        PFNGLBINDBUFFERRANGEPROC          BindBufferRange;
         PFNGLBINDSAMPLERPROC              BindSampler;
         PFNGLBINDTEXTUREPROC              BindTexture;
         PFNGLBINDVERTEXARRAYPROC          BindVertexArray;
@@ -511,6 +524,7 @@ union GL3WProcs {
         PFNGLGETSHADERIVPROC              GetShaderiv;
         PFNGLGETSTRINGPROC                GetString;
         PFNGLGETSTRINGIPROC               GetStringi;
+        PFNGLGETUNIFORMBLOCKINDEXPROC     GetUniformBlockIndex;
         PFNGLGETUNIFORMLOCATIONPROC       GetUniformLocation;
         PFNGLGETVERTEXATTRIBPOINTERVPROC  GetVertexAttribPointerv;
         PFNGLGETVERTEXATTRIBIVPROC        GetVertexAttribiv;
@@ -525,8 +539,10 @@ union GL3WProcs {
         PFNGLTEXIMAGE2DPROC               TexImage2D;
         PFNGLTEXPARAMETERIPROC            TexParameteri;
         PFNGLUNIFORM1IPROC                Uniform1i;
+        PFNGLUNIFORMBLOCKBINDINGPROC      UniformBlockBinding;
         PFNGLUNIFORMMATRIX4FVPROC         UniformMatrix4fv;
         PFNGLUSEPROGRAMPROC               UseProgram;
+        PFNGLVERTEXATTRIBIPOINTERPROC     VertexAttribIPointer;
         PFNGLVERTEXATTRIBPOINTERPROC      VertexAttribPointer;
         PFNGLVIEWPORTPROC                 Viewport;
     } gl;
@@ -538,6 +554,7 @@ GL3W_API extern union GL3WProcs imgl3wProcs;
 #define glActiveTexture                   imgl3wProcs.gl.ActiveTexture
 #define glAttachShader                    imgl3wProcs.gl.AttachShader
 #define glBindBuffer                      imgl3wProcs.gl.BindBuffer
+#define glBindBufferRange                 imgl3wProcs.gl.BindBufferRange
 #define glBindSampler                     imgl3wProcs.gl.BindSampler
 #define glBindTexture                     imgl3wProcs.gl.BindTexture
 #define glBindVertexArray                 imgl3wProcs.gl.BindVertexArray
@@ -576,6 +593,7 @@ GL3W_API extern union GL3WProcs imgl3wProcs;
 #define glGetShaderiv                     imgl3wProcs.gl.GetShaderiv
 #define glGetString                       imgl3wProcs.gl.GetString
 #define glGetStringi                      imgl3wProcs.gl.GetStringi
+#define glGetUniformBlockIndex            imgl3wProcs.gl.GetUniformBlockIndex
 #define glGetUniformLocation              imgl3wProcs.gl.GetUniformLocation
 #define glGetVertexAttribPointerv         imgl3wProcs.gl.GetVertexAttribPointerv
 #define glGetVertexAttribiv               imgl3wProcs.gl.GetVertexAttribiv
@@ -590,8 +608,10 @@ GL3W_API extern union GL3WProcs imgl3wProcs;
 #define glTexImage2D                      imgl3wProcs.gl.TexImage2D
 #define glTexParameteri                   imgl3wProcs.gl.TexParameteri
 #define glUniform1i                       imgl3wProcs.gl.Uniform1i
+#define glUniformBlockBinding             imgl3wProcs.gl.UniformBlockBinding
 #define glUniformMatrix4fv                imgl3wProcs.gl.UniformMatrix4fv
 #define glUseProgram                      imgl3wProcs.gl.UseProgram
+#define glVertexAttribIPointer            imgl3wProcs.gl.VertexAttribIPointer
 #define glVertexAttribPointer             imgl3wProcs.gl.VertexAttribPointer
 #define glViewport                        imgl3wProcs.gl.Viewport
 
@@ -736,6 +756,7 @@ static const char *proc_names[] = {
     "glActiveTexture",
     "glAttachShader",
     "glBindBuffer",
+    "glBindBufferRange",
     "glBindSampler",
     "glBindTexture",
     "glBindVertexArray",
@@ -774,6 +795,7 @@ static const char *proc_names[] = {
     "glGetShaderiv",
     "glGetString",
     "glGetStringi",
+    "glGetUniformBlockIndex",
     "glGetUniformLocation",
     "glGetVertexAttribPointerv",
     "glGetVertexAttribiv",
@@ -788,8 +810,10 @@ static const char *proc_names[] = {
     "glTexImage2D",
     "glTexParameteri",
     "glUniform1i",
+    "glUniformBlockBinding",
     "glUniformMatrix4fv",
     "glUseProgram",
+    "glVertexAttribIPointer",
     "glVertexAttribPointer",
     "glViewport",
 };
@@ -0,0 +1,428 @@
+#include "jobs.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+
+struct JobState
+{
+	std::function<void()> work;
+	// Dependencies still running, plus one while submit() is setting the job up
+	std::atomic<int> waitingOn;
+	std::atomic<bool> done;
+	// Guards "continuations" and the switch to done
+	std::mutex mutex;
+	std::vector<JobHandle> continuations;
+};
+
+// The pool and worker the current thread belongs to, NULL and -1 outside of any pool
+static thread_local JobSystem* currentSystem = NULL;
+static thread_local int currentWorker = -1;
+
+JobSystem::JobSystem(int workerCount)
+{
+	if (workerCount < 0)
+		workerCount = std::max(1, (int)std::thread::hardware_concurrency() - 1);
+
+	nextWorker = 0;
+	queued = 0;
+	sleeping = 0;
+	stopping = false;
+
+	for (int i = 0; i < workerCount; i++)
+		workers.push_back(std::unique_ptr<Worker>(new Worker()));
+
+	// Only start once every deque exists, workers steal from all of them
+	for (int i = 0; i < workerCount; i++)
+		workers[i]->thread = std::thread(&JobSystem::workerLoop, this, i);
+}
+
+JobSystem::~JobSystem()
+{
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		stopping = true;
+	}
+	sleepWake.notify_all();
+
+	for (std::unique_ptr<Worker>& worker : workers)
+		worker->thread.join();
+}
+
+int JobSystem::getThreadCount() const
+{
+	return (int)workers.size() + 1;
+}
+
+JobHandle JobSystem::submit(std::function<void()> work)
+{
+	return submit(std::move(work), std::vector<JobHandle>());
+}
+
+JobHandle JobSystem::submit(std::function<void()> work, const std::vector<JobHandle>& dependencies)
+{
+	JobHandle job = std::make_shared<JobState>();
+	job->work = std::move(work);
+	job->waitingOn = (int)dependencies.size() + 1;
+	job->done = false;
+
+	for (const JobHandle& dependency : dependencies)
+	{
+		{
+			std::lock_guard<std::mutex> lock(dependency->mutex);
+			if (!dependency->done)
+			{
+				// It queues us when it finishes
+				dependency->continuations.push_back(job);
+				continue;
+			}
+		}
+
+		job->waitingOn--;
+	}
+
+	if (--job->waitingOn == 0)
+		enqueue(job);
+
+	return job;
+}
+
+JobHandle JobSystem::then(const JobHandle& job, std::function<void()> work)
+{
+	return submit(std::move(work), std::vector<JobHandle>(1, job));
+}
+
+bool JobSystem::isDone(const JobHandle& job)
+{
+	return job->done.load(std::memory_order_acquire);
+}
+
+void JobSystem::wait(const JobHandle& job)
+{
+	int self = currentSystem == this ? currentWorker : -1;
+
+	while (!isDone(job))
+	{
+		if (!runOne(self))
+			std::this_thread::yield();
+	}
+}
+
+void JobSystem::parallelFor(size_t begin, size_t end, size_t grain, const std::function<void(size_t, size_t)>& body)
+{
+	if (end <= begin)
+		return;
+	if (grain < 1)
+		grain = 1;
+
+	size_t count = end - begin;
+	size_t chunks = std::min((count + grain - 1) / grain, (size_t)getThreadCount() * JOBS_CHUNKS_PER_WORKER);
+	if (chunks <= 1 || workers.empty())
+	{
+		body(begin, end);
+		return;
+	}
+
+	size_t chunkSize = (count + chunks - 1) / chunks;
+	chunks = (count + chunkSize - 1) / chunkSize;
+
+	// Lives on our stack, every chunk is done before we return
+	std::atomic<size_t> remaining(chunks);
+
+	for (size_t chunk = 1; chunk < chunks; chunk++)
+	{
+		size_t chunkBegin = begin + chunk * chunkSize;
+		size_t chunkEnd = std::min(end, chunkBegin + chunkSize);
+
+		submit([&body, &remaining, chunkBegin, chunkEnd]()
+		{
+			body(chunkBegin, chunkEnd);
+			remaining.fetch_sub(1, std::memory_order_release);
+		});
+	}
+
+	// The first chunk is ours, then help with the rest
+	body(begin, std::min(end, begin + chunkSize));
+	remaining.fetch_sub(1, std::memory_order_release);
+
+	int self = currentSystem == this ? currentWorker : -1;
+	while (remaining.load(std::memory_order_acquire) > 0)
+	{
+		if (!runOne(self))
+			std::this_thread::yield();
+	}
+}
+
+void JobSystem::enqueue(const JobHandle& job)
+{
+	// Without workers whoever queues the job runs it
+	if (workers.empty())
+	{
+		job->work();
+		finish(job);
+		return;
+	}
+
+	// Workers keep their own jobs, others are dealt out in turn
+	int target = currentSystem == this ? currentWorker : -1;
+	if (target < 0)
+		target = (int)(nextWorker++ % workers.size());
+
+	{
+		std::lock_guard<std::mutex> lock(workers[target]->mutex);
+		workers[target]->jobs.push_back(job);
+	}
+
+	queued++;
+	if (sleeping > 0)
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		sleepWake.notify_one();
+	}
+}
+
+void JobSystem::finish(const JobHandle& job)
+{
+	// Drop the captures now, the handle may be kept around for a while
+	job->work = nullptr;
+
+	std::vector<JobHandle> next;
+	{
+		std::lock_guard<std::mutex> lock(job->mutex);
+		job->done.store(true, std::memory_order_release);
+		next.swap(job->continuations);
+	}
+
+	for (const JobHandle& continuation : next)
+	{
+		if (--continuation->waitingOn == 0)
+			enqueue(continuation);
+	}
+}
+
+JobHandle JobSystem::pop(int self)
+{
+	Worker& worker = *workers[self];
+	std::lock_guard<std::mutex> lock(worker.mutex);
+	if (worker.jobs.empty())
+		return NULL;
+
+	JobHandle job = worker.jobs.back();
+	worker.jobs.pop_back();
+	return job;
+}
+
+JobHandle JobSystem::steal(int self)
+{
+	int count = (int)workers.size();
+	int start = self >= 0 ? self + 1 : (int)(nextWorker % count);
+
+	for (int i = 0; i < count; i++)
+	{
+		Worker& victim = *workers[(start + i) % count];
+		if (&victim == (self >= 0 ? workers[self].get() : NULL))
+			continue;
+
+		std::lock_guard<std::mutex> lock(victim.mutex);
+		if (victim.jobs.empty())
+			continue;
+
+		// Oldest first, those tend to be the biggest pieces of work
+		JobHandle job = victim.jobs.front();
+		victim.jobs.pop_front();
+		return job;
+	}
+
+	return NULL;
+}
+
+bool JobSystem::runOne(int self)
+{
+	if (workers.empty() || queued <= 0)
+		return false;
+
+	JobHandle job = self >= 0 ? pop(self) : NULL;
+	if (job == NULL)
+		job = steal(self);
+	if (job == NULL)
+		return false;
+
+	queued--;
+	job->work();
+	finish(job);
+	return true;
+}
+
+void JobSystem::workerLoop(int index)
+{
+	currentSystem = this;
+	currentWorker = index;
+
+	while (true)
+	{
+		if (runOne(index))
+			continue;
+
+		std::unique_lock<std::mutex> lock(sleepMutex);
+		sleeping++;
+		sleepWake.wait(lock, [this]() { return queued > 0 || stopping; });
+		sleeping--;
+
+		if (stopping && queued <= 0)
+			break;
+	}
+
+	currentSystem = NULL;
+	currentWorker = -1;
+}
+
+/*
+Checks of the job system on one thread count.
+*/
+static bool checkJobs(JobSystem& jobs)
+{
+	bool passed = true;
+
+	// parallelFor visits every index exactly once
+	{
+		std::vector<int> hits(1000003, 0);
+		jobs.parallelFor(0, hits.size(), 1000, [&hits](size_t begin, size_t end)
+		{
+			for (size_t i = begin; i < end; i++)
+				hits[i]++;
+		});
+
+		bool once = std::all_of(hits.begin(), hits.end(), [](int hit) { return hit == 1; });
+		printf("  parallelFor covers every index once: %s\n", once ? "ok" : "FAILED");
+		passed &= once;
+	}
+
+	// Dependencies: a before b and c, d after both
+	{
+		std::atomic<int> clock(0);
+		int a = 0, b = 0, c = 0, d = 0;
+
+		JobHandle jobA = jobs.submit([&]() { std::this_thread::sleep_for(std::chrono::milliseconds(5)); a = ++clock; });
+		JobHandle jobB = jobs.then(jobA, [&]() { b = ++clock; });
+		JobHandle jobC = jobs.then(jobA, [&]() { c = ++clock; });
+		JobHandle jobD = jobs.submit([&]() { d = ++clock; }, { jobB, jobC });
+		jobs.wait(jobD);
+
+		bool ordered = a < b && a < c && b < d && c < d;
+		printf("  dependencies run in order: %s\n", ordered ? "ok" : "FAILED");
+		passed &= ordered;
+	}
+
+	// Lots of tiny jobs, all of them run
+	{
+		std::atomic<int> sum(0);
+		std::vector<JobHandle> handles;
+		for (int i = 0; i < 10000; i++)
+			handles.push_back(jobs.submit([&sum]() { sum++; }));
+
+		JobHandle all = jobs.submit([]() {}, handles);
+		jobs.wait(all);
+
+		bool complete = sum == 10000;
+		printf("  10000 small jobs: %s\n", complete ? "ok" : "FAILED");
+		passed &= complete;
+	}
+
+	// Waiting from inside a job, the waiting worker has to help instead of blocking
+	{
+		std::atomic<long long> total(0);
+		JobHandle outer = jobs.submit([&jobs, &total]()
+		{
+			jobs.parallelFor(0, 100000, 100, [&total](size_t begin, size_t end)
+			{
+				long long sum = 0;
+				for (size_t i = begin; i < end; i++)
+					sum += (long long)i;
+				total += sum;
+			});
+		});
+		jobs.wait(outer);
+
+		bool nested = total == 100000LL * 99999LL / 2;
+		printf("  parallelFor inside a job: %s\n", nested ? "ok" : "FAILED");
+		passed &= nested;
+	}
+
+	return passed;
+}
+
+// Compute bound work for the scaling benchmark, memory bandwidth would flatten the curve
+static void scalingKernel(float* values, size_t begin, size_t end)
+{
+	for (size_t i = begin; i < end; i++)
+	{
+		float x = values[i];
+		for (int step = 0; step < 64; step++)
+			x = sqrtf(x * x + 0.5f) * 0.75f;
+		values[i] = x;
+	}
+}
+
+bool testJobs(int maxThreads)
+{
+	if (maxThreads <= 0)
+		maxThreads = std::max(1, (int)std::thread::hardware_concurrency());
+
+	// The calling thread alone, then every thread, which is where races would show
+	bool passed = true;
+	int threadCounts[2] = { 1, maxThreads };
+	for (int i = 0; i < (maxThreads > 1 ? 2 : 1); i++)
+	{
+		JobSystem jobs(threadCounts[i] - 1);
+		printf("Job system checks, %d threads\n", jobs.getThreadCount());
+		passed &= checkJobs(jobs);
+	}
+
+	printf("Checks %s\n", passed ? "passed" : "FAILED");
+	return passed;
+}
+
+void benchmarkJobs(int maxThreads)
+{
+	typedef std::chrono::high_resolution_clock Clock;
+
+	if (maxThreads <= 0)
+		maxThreads = std::max(1, (int)std::thread::hardware_concurrency());
+
+	const size_t count = 1 << 20;
+	std::vector<float> values(count);
+
+	printf("parallelFor scaling, %zu elements\n", count);
+	printf("%-8s %10s %10s %12s\n", "Threads", "ms", "Speedup", "Efficiency");
+
+	double single = 0.0;
+	for (int threads = 1; threads <= maxThreads; threads++)
+	{
+		JobSystem jobs(threads - 1);
+
+		// Best of a few runs
+		double best = 0.0;
+		for (int run = 0; run < 5; run++)
+		{
+			for (size_t i = 0; i < count; i++)
+				values[i] = (float)(i & 1023);
+
+			Clock::time_point start = Clock::now();
+			jobs.parallelFor(0, count, 4096, [&values](size_t begin, size_t end)
+			{
+				scalingKernel(values.data(), begin, end);
+			});
+			double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+			if (run == 0 || ms < best)
+				best = ms;
+		}
+
+		if (threads == 1)
+			single = best;
+
+		double speedup = single / best;
+		printf("%-8d %10.2f %9.2fx %11.0f%%\n", threads, best, speedup, speedup / threads * 100.0);
+	}
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#ifndef JOBS_H
+#define JOBS_H
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Chunks per worker parallelFor splits a range into at most, more chunks balance better
+#define JOBS_CHUNKS_PER_WORKER 4
+
+struct JobState;
+typedef std::shared_ptr<JobState> JobHandle;
+
+/*
+Work-stealing thread pool.
+
+Every worker has its own deque: it pushes and pops its own jobs at the back, idle workers
+steal from the front of the others. Jobs submitted from outside the pool are dealt to the
+workers in turn. A job can depend on other jobs, it's queued once they have all finished,
+which is also how continuations are written.
+
+Waiting, in wait() or parallelFor(), runs queued jobs in the meantime, so the caller
+helps out and waiting from inside a job can't deadlock the pool.
+*/
+class JobSystem
+{
+public:
+	// Worker threads besides the callers, -1 picks one per core leaving one for the main thread.
+	// With 0 every job runs on the thread that queues or waits for it.
+	JobSystem(int workerCount = -1);
+	~JobSystem();
+
+	JobSystem(const JobSystem&) = delete;
+	JobSystem& operator=(const JobSystem&) = delete;
+
+	JobHandle submit(std::function<void()> work);
+	// Runs "work" after all of "dependencies" finished
+	JobHandle submit(std::function<void()> work, const std::vector<JobHandle>& dependencies);
+	// Continuation, runs "work" after "job"
+	JobHandle then(const JobHandle& job, std::function<void()> work);
+
+	void wait(const JobHandle& job);
+	static bool isDone(const JobHandle& job);
+
+	/*
+	Call body(begin, end) over chunks of [begin, end), in parallel, and return once all are
+	done. Chunks have at least "grain" indices, so tiny ranges stay on the caller.
+	*/
+	void parallelFor(size_t begin, size_t end, size_t grain, const std::function<void(size_t, size_t)>& body);
+
+	// Workers plus the calling thread
+	int getThreadCount() const;
+
+private:
+	struct Worker
+	{
+		std::thread thread;
+		std::mutex mutex;
+		std::deque<JobHandle> jobs;
+	};
+
+	void enqueue(const JobHandle& job);
+	void finish(const JobHandle& job);
+	// Run one queued job, own deque first, then steal. False if there was nothing to run.
+	bool runOne(int self);
+	JobHandle pop(int self);
+	JobHandle steal(int self);
+	void workerLoop(int index);
+
+	std::vector<std::unique_ptr<Worker>> workers;
+	std::atomic<unsigned int> nextWorker;
+
+	// Sleeping workers wait here for "queued" to go up
+	std::mutex sleepMutex;
+	std::condition_variable sleepWake;
+	std::atomic<int> queued;
+	std::atomic<int> sleeping;
+	bool stopping;
+};
+
+/*
+Runs the job system checks on one thread and on "maxThreads" threads (0 for every core),
+printed to stdout. Returns false if a check failed.
+*/
+bool testJobs(int maxThreads);
+
+/*
+Runs the parallelFor scaling benchmark from 1 to "maxThreads" threads (0 for every core),
+printed to stdout.
+*/
+void benchmarkJobs(int maxThreads);
+
+#endif // !JOBS_H
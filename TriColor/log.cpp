@@ -0,0 +1,208 @@
+#include "log.h"
+
+#include <cstdarg>
+#include <cstddef>
+#include <cstdio>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+static const char* levelPrefixes[] = {
+	"[debug] ",
+	"",
+	"[warning] ",
+	"[error] "
+};
+
+/*
+Bounded multi-producer ring (Vyukov). Every slot carries a sequence number: a producer may
+fill slot "pos" once its sequence equals pos, and hands it over by setting it to pos + 1.
+The consumer gives the slot back for the next lap with pos + LOG_RING_SIZE.
+*/
+struct LogSlot
+{
+	std::atomic<size_t> sequence;
+	LogLevel level;
+	char text[LOG_MESSAGE_SIZE];
+};
+
+struct LogRing
+{
+	LogSlot slots[LOG_RING_SIZE];
+	std::atomic<size_t> enqueuePos;
+	// Only touched with consumerMutex held
+	size_t dequeuePos;
+
+	LogRing()
+	{
+		for (size_t i = 0; i < LOG_RING_SIZE; i++)
+			slots[i].sequence.store(i, std::memory_order_relaxed);
+		enqueuePos.store(0, std::memory_order_relaxed);
+		dequeuePos = 0;
+	}
+};
+
+static LogRing ring;
+static std::atomic<int> minLevel(LOG_LEVEL_INFO);
+static std::atomic<unsigned int> dropped(0);
+
+// Writer thread, producers never touch any of this
+static std::mutex consumerMutex;
+static std::mutex writerMutex;
+static std::condition_variable writerWake;
+static std::thread writer;
+static bool writerRunning = false;
+
+static long long nowMs()
+{
+	return std::chrono::duration_cast<std::chrono::milliseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Write every finished message, with consumerMutex held
+static void drain()
+{
+	bool wrote = false;
+
+	while (true)
+	{
+		LogSlot& slot = ring.slots[ring.dequeuePos & (LOG_RING_SIZE - 1)];
+		if (slot.sequence.load(std::memory_order_acquire) != ring.dequeuePos + 1)
+			break;
+
+		fputs(levelPrefixes[slot.level], stdout);
+		fputs(slot.text, stdout);
+		fputc('\n', stdout);
+		wrote = true;
+
+		slot.sequence.store(ring.dequeuePos + LOG_RING_SIZE, std::memory_order_release);
+		ring.dequeuePos++;
+	}
+
+	if (wrote)
+		fflush(stdout);
+}
+
+static void writerLoop()
+{
+	std::unique_lock<std::mutex> lock(writerMutex);
+
+	while (writerRunning)
+	{
+		lock.unlock();
+		{
+			std::lock_guard<std::mutex> consumer(consumerMutex);
+			drain();
+		}
+		lock.lock();
+
+		writerWake.wait_for(lock, std::chrono::milliseconds(LOG_WRITER_INTERVAL_MS));
+	}
+}
+
+void logStart()
+{
+	std::lock_guard<std::mutex> lock(writerMutex);
+	if (writerRunning)
+		return;
+
+	writerRunning = true;
+	writer = std::thread(writerLoop);
+}
+
+void logStop()
+{
+	{
+		std::lock_guard<std::mutex> lock(writerMutex);
+		if (!writerRunning)
+			return;
+		writerRunning = false;
+	}
+
+	writerWake.notify_one();
+	writer.join();
+	logFlush();
+}
+
+void logFlush()
+{
+	std::lock_guard<std::mutex> consumer(consumerMutex);
+	drain();
+}
+
+void logSetLevel(LogLevel level)
+{
+	minLevel.store(level, std::memory_order_relaxed);
+}
+
+unsigned int logGetDropped()
+{
+	return dropped.load(std::memory_order_relaxed);
+}
+
+// Whether the site may log now, counts the suppressed messages otherwise
+static bool allowSite(LogSite& site)
+{
+	long long now = nowMs();
+	long long start = site.windowStart.load(std::memory_order_relaxed);
+
+	// New one second window, only one thread gets to reset it
+	if (now - start >= 1000 && site.windowStart.compare_exchange_strong(start, now, std::memory_order_relaxed))
+		site.count.store(0, std::memory_order_relaxed);
+
+	if (site.count.fetch_add(1, std::memory_order_relaxed) < LOG_SITE_RATE)
+		return true;
+
+	site.suppressed.fetch_add(1, std::memory_order_relaxed);
+	return false;
+}
+
+void logWrite(LogLevel level, LogSite& site, const char* format, ...)
+{
+	if (level < minLevel.load(std::memory_order_relaxed) || !allowSite(site))
+		return;
+
+	// Claim a slot
+	size_t pos = ring.enqueuePos.load(std::memory_order_relaxed);
+	LogSlot* slot;
+	while (true)
+	{
+		slot = &ring.slots[pos & (LOG_RING_SIZE - 1)];
+		size_t sequence = slot->sequence.load(std::memory_order_acquire);
+		ptrdiff_t diff = (ptrdiff_t)sequence - (ptrdiff_t)pos;
+
+		if (diff == 0)
+		{
+			if (ring.enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+				break;
+		}
+		else if (diff < 0)
+		{
+			// Full, the writer is a whole ring behind
+			dropped.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+		else
+		{
+			pos = ring.enqueuePos.load(std::memory_order_relaxed);
+		}
+	}
+
+	va_list args;
+	va_start(args, format);
+	int length = vsnprintf(slot->text, LOG_MESSAGE_SIZE, format, args);
+	va_end(args);
+
+	if (length < 0)
+		length = 0;
+	if (length >= LOG_MESSAGE_SIZE)
+		length = LOG_MESSAGE_SIZE - 1;
+
+	int suppressed = site.suppressed.exchange(0, std::memory_order_relaxed);
+	if (suppressed > 0)
+		snprintf(slot->text + length, LOG_MESSAGE_SIZE - length, " (%d similar suppressed)", suppressed);
+
+	slot->level = level;
+	slot->sequence.store(pos + 1, std::memory_order_release);
+}
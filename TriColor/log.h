@@ -0,0 +1,61 @@
+#pragma once
+
+#ifndef LOG_H
+#define LOG_H
+#include <atomic>
+
+// Messages waiting for the writer thread, a power of two. Once full new messages are dropped.
+#define LOG_RING_SIZE 256
+// Longest message in bytes, longer ones are cut
+#define LOG_MESSAGE_SIZE 1024
+// Messages per call site and second, the rest are counted and reported with the next one
+#define LOG_SITE_RATE 10
+// How often the writer thread looks for new messages
+#define LOG_WRITER_INTERVAL_MS 10
+
+enum LogLevel
+{
+	LOG_LEVEL_DEBUG,
+	LOG_LEVEL_INFO,
+	LOG_LEVEL_WARNING,
+	LOG_LEVEL_ERROR
+};
+
+/*
+Rate limit state of one call site, the LOG_ macros keep one per call.
+*/
+struct LogSite
+{
+	std::atomic<long long> windowStart;
+	std::atomic<int> count;
+	std::atomic<int> suppressed;
+};
+
+/*
+Asynchronous logging. Callers only format into a lock-free ring buffer, a background thread
+does the writing to stdout, so a slow terminal or a full pipe never stalls the render loop.
+Any thread may log.
+
+Messages logged before logStart() wait in the ring. logStop() writes what's left and ends
+the thread, call it before returning from main.
+*/
+void logStart();
+void logStop();
+// Block until everything logged so far is written
+void logFlush();
+
+// Messages below this level are discarded, LOG_LEVEL_INFO by default
+void logSetLevel(LogLevel level);
+
+// Messages dropped because the ring was full
+unsigned int logGetDropped();
+
+void logWrite(LogLevel level, LogSite& site, const char* format, ...);
+
+#define LOG(level, ...) do { static LogSite logSite; logWrite(level, logSite, __VA_ARGS__); } while (0)
+#define LOG_DEBUG(...) LOG(LOG_LEVEL_DEBUG, __VA_ARGS__)
+#define LOG_INFO(...) LOG(LOG_LEVEL_INFO, __VA_ARGS__)
+#define LOG_WARNING(...) LOG(LOG_LEVEL_WARNING, __VA_ARGS__)
+#define LOG_ERROR(...) LOG(LOG_LEVEL_ERROR, __VA_ARGS__)
+
+#endif // !LOG_H
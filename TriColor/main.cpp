@@ -1,4 +1,8 @@
+#include <algorithm>
 #include <iostream>
+#include <vector>
+#include <cmath>
+#include <cstring>
 
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
@@ -8,17 +12,58 @@
 #include "imgui_impl_opengl3.h"
 
 #include "shader.h"
+#include "shaderlibrary.h"
+#include "shadercompiler.h"
+#include "glextensions.h"
+#include "streambuffer.h"
+#include "filewatcher.h"
+#include "profiler.h"
+#include "colorconv.h"
+#include "log.h"
+#include "uipipeline.h"
+#include "jobs.h"
+#include "scene.h"
+#include "batcher.h"
+#include "mesh.h"
+#include "culling.h"
+#include "pickgrid.h"
 
 #define GLSL_VERSION "#version 330 core"
 #define SCREEN_WIDTH 640
 #define SCREEN_HEIGHT 480
 #define APP_TITLE "TriColor"
+#define MAX_TRIANGLE_COUNT 1000000
+#define HEADLESS_DEFAULT_FRAMES 300
+// Fixed simulation rate and triangle speed in units per second
+#define SIMULATION_DEFAULT_HZ 60
+#define TRIANGLE_SPEED 0.6f
+// Longest frame the simulation catches up on, so a stall doesn't end in a spiral of steps
+#define SIMULATION_MAX_FRAME_TIME 0.25
+// Quiet frames before going idle, and how long an idle wait lasts at most (seconds)
+#define IDLE_GRACE_FRAMES 3
+#define IDLE_WAIT_TIMEOUT 0.5
+// Smallest triangle culling keeps, in pixels across
+#define CULL_DEFAULT_MIN_PIXELS 1.0f
+// Instance slots start on this boundary, the largest GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT
+// GL allows, so the culling pass can bind the current slot as a storage buffer
+#define INSTANCE_SLOT_ALIGNMENT 256
+// Colors per batch in the HSV conversion benchmark
+#define HSV_BENCH_COUNT (1 << 20)
 
 typedef std::string string;
 
+// Set when the window has to be drawn again even if nothing else changed
+static bool redrawRequested = false;
+
 void frameBufferSizeCallback(GLFWwindow* window, int width, int height)
 {
 	glViewport(0, 0, width, height);
+	redrawRequested = true;
+}
+
+void windowRefreshCallback(GLFWwindow*)
+{
+	redrawRequested = true;
 }
 
 string getFilePath(string filename)
@@ -31,279 +76,1412 @@ string getFilePath(string filename)
 }
 
 /*
-A function that takes an array of HSV and convert it to RGB.
-*/ 
-ImVec4 hsv2rgb(ImVec4 hsv)
+Bytes of one frame's instance data, rounded up to INSTANCE_SLOT_ALIGNMENT.
+*/
+size_t instanceSlotSize(size_t count)
+{
+	size_t size = count * sizeof(TriangleInstance);
+	return (size + INSTANCE_SLOT_ALIGNMENT - 1) / INSTANCE_SLOT_ALIGNMENT * INSTANCE_SLOT_ALIGNMENT;
+}
+
+/*
+Scale of every triangle so larger counts don't cover the whole screen.
+*/
+float triangleScale(int count)
 {
-	hsv.x /= 255.0f;
-	hsv.y /= 255.0f;
-	hsv.z /= 255.0f;
+	if (count <= 1)
+		return 1.0f;
+
+	return fmaxf(1.0f / sqrtf((float)count), 0.01f);
+}
 
-	int hi = ((int)hsv.x * 6) % 6;
-	int f = hsv.x * 6 - hi;
-	int p = hsv.z * (1 - hsv.y);
-	int q = hsv.z * (1 - f * hsv.y);
-	int t = hsv.z * (1 - (1 - f) * hsv.y);
+/*
+Where the color animation is computed.
+*/
+enum ColorAnimationMode
+{
+	// TriangleVertex.glsl computes the tints from uTime
+	COLOR_ANIM_GPU,
+	// hsv2rgb on the CPU, the tints are streamed with the instances
+	COLOR_ANIM_CPU
+};
 
-	printf("hi: %d, f: %d, p: %d, q: %d, t: %d\n", hi, f, p, q, t);
+static const char* colorAnimationModeNames[] = { "gpu", "cpu" };
 
-	switch (hi)
+static const char* cullModeNames[] = { "off", "gpu", "cpu" };
+
+/*
+The wave both animation paths follow, a hue between 0 and 1.
+*/
+float colorWave(float time)
+{
+	return 0.5f + 0.5f * sinf(time);
+}
+
+/*
+How buffer swaps are paced.
+*/
+enum SwapMode
+{
+	SWAP_VSYNC,
+	// Vsync, but late frames are shown right away (swap_control_tear)
+	SWAP_ADAPTIVE,
+	SWAP_UNCAPPED
+};
+
+static const char* swapModeNames[] = { "vsync", "adaptive", "uncapped" };
+
+void applySwapMode(SwapMode mode)
+{
+	switch (mode)
 	{
-	case 0:
-		return ImVec4(hsv.z, t, p, 1.0f);
-	case 1:
-		return ImVec4(q, hsv.z, p, 1.0f);
-	case 2:
-		return ImVec4(p, hsv.z, t, 1.0f);
-	case 3:
-		return ImVec4(p, q, hsv.z, 1.0f);
-	case 4:
-		return ImVec4(t, p, hsv.z, 1.0f);
-	default:
-		return ImVec4(hsv.z, p, q, 1.0f);
+	case SWAP_VSYNC:
+		glfwSwapInterval(1);
+		break;
+	case SWAP_ADAPTIVE:
+		// A negative interval needs swap_control_tear, otherwise it's plain vsync
+		if (glfwExtensionSupported("WGL_EXT_swap_control_tear") || glfwExtensionSupported("GLX_EXT_swap_control_tear"))
+			glfwSwapInterval(-1);
+		else
+			glfwSwapInterval(1);
+		break;
+	case SWAP_UNCAPPED:
+		glfwSwapInterval(0);
+		break;
 	}
 }
 
+/*
+Command line options.
+*/
+struct AppOptions
+{
+	// Render offscreen for a fixed number of frames, then print a report and exit
+	bool headless;
+	int frames;
+	SwapMode swapMode;
+	int simulationHz;
+	int triangleCount;
+	// Start with the color animation on, and where it runs
+	bool animate;
+	ColorAnimationMode animationMode;
+	// Start with the triangles drifting around
+	bool drift;
+	CullMode cullMode;
+	LogLevel logLevel;
+	// Build the UI on a worker thread, one frame ahead of drawing
+	bool pipelinedUi;
+	// Threads of the job system including the main thread, 0 for one per core
+	int threads;
+	// Mesh file to stream in, empty for none
+	string meshPath;
+	// Write a test mesh of this many triangles to meshPath instead of running the app
+	unsigned long long makeMeshTriangles;
+	// Run this benchmark instead of the app, empty for none
+	string bench;
+	// Run these checks instead of the app, empty for none
+	string test;
+};
+
+bool printUsage(const char* program)
+{
+	printf("Usage: %s [--headless] [--frames N] [--swap vsync|adaptive|uncapped] [--sim-hz N] [--triangles N] [--animate gpu|cpu] [--drift] [--cull off|gpu|cpu] [--log debug|info|warning|error] [--pipelined-ui] [--threads N] [--mesh file.tcm] [--make-mesh file.tcm triangles] [--bench hsv|jobs|scene|pick] [--test jobs]\n", program);
+	return false;
+}
+
+bool parseOptions(int argc, char** argv, AppOptions& options)
+{
+	options.headless = false;
+	options.frames = HEADLESS_DEFAULT_FRAMES;
+	options.swapMode = SWAP_VSYNC;
+	options.simulationHz = SIMULATION_DEFAULT_HZ;
+	options.triangleCount = 1;
+	options.animate = false;
+	options.animationMode = COLOR_ANIM_GPU;
+	options.drift = false;
+	options.cullMode = CULL_OFF;
+	options.logLevel = LOG_LEVEL_INFO;
+	options.pipelinedUi = false;
+	options.threads = 0;
+	options.meshPath.clear();
+	options.makeMeshTriangles = 0;
+	options.bench.clear();
+	options.test.clear();
+	bool swapModeSet = false;
+
+	for (int i = 1; i < argc; i++)
+	{
+		string arg = argv[i];
+
+		if (arg == "--headless")
+		{
+			options.headless = true;
+		}
+		else if (arg == "--frames" && i + 1 < argc)
+		{
+			options.frames = atoi(argv[++i]);
+			if (options.frames < 1)
+				options.frames = 1;
+		}
+		else if (arg == "--swap" && i + 1 < argc)
+		{
+			string mode = argv[++i];
+			if (mode == "vsync")
+				options.swapMode = SWAP_VSYNC;
+			else if (mode == "adaptive")
+				options.swapMode = SWAP_ADAPTIVE;
+			else if (mode == "uncapped")
+				options.swapMode = SWAP_UNCAPPED;
+			else
+				return printUsage(argv[0]);
+			swapModeSet = true;
+		}
+		else if (arg == "--sim-hz" && i + 1 < argc)
+		{
+			options.simulationHz = atoi(argv[++i]);
+			if (options.simulationHz < 1)
+				options.simulationHz = 1;
+		}
+		else if (arg == "--triangles" && i + 1 < argc)
+		{
+			options.triangleCount = atoi(argv[++i]);
+			if (options.triangleCount < 1)
+				options.triangleCount = 1;
+			if (options.triangleCount > MAX_TRIANGLE_COUNT)
+				options.triangleCount = MAX_TRIANGLE_COUNT;
+		}
+		else if (arg == "--animate" && i + 1 < argc)
+		{
+			string mode = argv[++i];
+			if (mode == "gpu")
+				options.animationMode = COLOR_ANIM_GPU;
+			else if (mode == "cpu")
+				options.animationMode = COLOR_ANIM_CPU;
+			else
+				return printUsage(argv[0]);
+			options.animate = true;
+		}
+		else if (arg == "--drift")
+		{
+			options.drift = true;
+		}
+		else if (arg == "--cull" && i + 1 < argc)
+		{
+			string mode = argv[++i];
+			if (mode == "off")
+				options.cullMode = CULL_OFF;
+			else if (mode == "gpu")
+				options.cullMode = CULL_GPU;
+			else if (mode == "cpu")
+				options.cullMode = CULL_CPU;
+			else
+				return printUsage(argv[0]);
+		}
+		else if (arg == "--log" && i + 1 < argc)
+		{
+			string level = argv[++i];
+			if (level == "debug")
+				options.logLevel = LOG_LEVEL_DEBUG;
+			else if (level == "info")
+				options.logLevel = LOG_LEVEL_INFO;
+			else if (level == "warning")
+				options.logLevel = LOG_LEVEL_WARNING;
+			else if (level == "error")
+				options.logLevel = LOG_LEVEL_ERROR;
+			else
+				return printUsage(argv[0]);
+		}
+		else if (arg == "--pipelined-ui")
+		{
+			options.pipelinedUi = true;
+		}
+		else if (arg == "--threads" && i + 1 < argc)
+		{
+			options.threads = atoi(argv[++i]);
+			if (options.threads < 0)
+				options.threads = 0;
+		}
+		else if (arg == "--mesh" && i + 1 < argc)
+		{
+			options.meshPath = argv[++i];
+		}
+		else if (arg == "--make-mesh" && i + 2 < argc)
+		{
+			options.meshPath = argv[++i];
+			options.makeMeshTriangles = strtoull(argv[++i], NULL, 10);
+			if (options.makeMeshTriangles < 1)
+				return printUsage(argv[0]);
+		}
+		else if (arg == "--bench" && i + 1 < argc)
+		{
+			options.bench = argv[++i];
+			if (options.bench != "hsv" && options.bench != "jobs" && options.bench != "scene" && options.bench != "pick")
+				return printUsage(argv[0]);
+		}
+		else if (arg == "--test" && i + 1 < argc)
+		{
+			options.test = argv[++i];
+			if (options.test != "jobs")
+				return printUsage(argv[0]);
+		}
+		else
+		{
+			return printUsage(argv[0]);
+		}
+	}
+
+	// Benchmarks shouldn't be capped by the display unless asked to
+	if (options.headless && !swapModeSet)
+		options.swapMode = SWAP_UNCAPPED;
+
+	return true;
+}
+
+/*
+Keys held during a frame, consumed by every simulation step of that frame.
+*/
+struct SimulationInput
+{
+	bool up;
+	bool left;
+	bool down;
+	bool right;
+};
+
+/*
+Keep the triangle inside the border.
+*/
+void clampToBorder(float* position)
+{
+	if ((position[0]) >= 0.5f)
+		position[0] = 0.5f;
+	if ((position[0]) <= -0.5f)
+		position[0] = -0.5f;
+	if ((position[1]) >= 0.5f)
+		position[1] = 0.5f;
+	if ((position[1]) <= -0.5f)
+		position[1] = -0.5f;
+}
+
+/*
+Advance the triangle by one fixed step of "dt" seconds.
+*/
+void simulateStep(float* position, const SimulationInput& input, float dt)
+{
+	float step = TRIANGLE_SPEED * dt;
+
+	if (input.up)
+		position[1] += step;
+	if (input.left)
+		position[0] -= step;
+	if (input.down)
+		position[1] -= step;
+	if (input.right)
+		position[0] += step;
+
+	clampToBorder(position);
+}
+
+/*
+FNV-1a hash of the pixels of the bound read framebuffer, for pixel regression checks.
+*/
+unsigned long long hashFramebuffer(int width, int height)
+{
+	std::vector<unsigned char> pixels((size_t)width * height * 4);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+
+	unsigned long long hash = 14695981039346656037ull;
+	for (unsigned char c : pixels)
+	{
+		hash ^= c;
+		hash *= 1099511628211ull;
+	}
+
+	return hash;
+}
+
+/*
+MB/s of a mesh load, counting only the uploads and counting the frames in between.
+*/
+double meshUploadRate(const MeshLoadStats& stats)
+{
+	return stats.uploadMs > 0.0 ? stats.bytesUploaded / (1024.0 * 1024.0) / (stats.uploadMs / 1000.0) : 0.0;
+}
+
+double meshOverallRate(const MeshLoadStats& stats)
+{
+	return stats.elapsedMs > 0.0 ? stats.bytesUploaded / (1024.0 * 1024.0) / (stats.elapsedMs / 1000.0) : 0.0;
+}
+
+/*
+Everything the UI shows or edits. The UI works on its own copy only, synced with the app
+between UI frames, so it can be built on another thread while the app draws.
+*/
+struct UiState
+{
+	// Settings, the UI edits them and the app picks the changes up
+	ImVec4 colors;
+	bool animate;
+	ColorAnimationMode animationMode;
+	int simulationHz;
+	int triangleCount;
+	bool drift;
+	CullMode cullMode;
+	float cullMinPixels;
+	SwapMode swapMode;
+	bool enableIdle;
+	bool pipelined;
+
+	// Only the UI uses these
+	bool showConfigWindow;
+	bool showPerformanceWindow;
+	bool showDemoWindow;
+
+	// Requests to the app, cleared once handled
+	float nudge[2];
+	bool resetPosition;
+	bool reloadShader;
+	bool exit;
+	bool sceneClicked;
+
+	// Filled in by the app for display
+	float position[2];
+	int simulationSteps;
+	unsigned int framesSkipped;
+	ShaderStatus shaderStatus;
+	string shaderLog;
+	StreamBufferStats streamStats;
+	unsigned int uniformUploads;
+	unsigned int uniformSkips;
+	double uiBuildMs;
+	ImGui_ImplOpenGL3_RenderStats uiRenderStats;
+	BatchStats batchStats;
+	bool cullSupported;
+	size_t drawnCount;
+	size_t culledCount;
+	string meshPath;
+	MeshLoadStats meshStats;
+	float meshProgress;
+	// Triangle under the cursor and the one clicked, -1 for none
+	long long hovered;
+	long long selected;
+	SceneEntity selectedEntity;
+	PickStats pickStats;
+
+	// Set by the UI, the user is hovering or using a widget
+	bool interacting;
+	// Cursor in normalized device coordinates, and whether it's over the scene and not a window
+	float mouse[2];
+	bool sceneHovered;
+};
+
+/*
+Take a setting over from the UI if it changed it since the last sync, then hand the UI the
+current value. "sent" is what the UI was given last time.
+*/
+template<typename T>
+void syncSetting(T& app, T& ui, T& sent)
+{
+	if (memcmp(&ui, &sent, sizeof(T)) != 0)
+		app = ui;
+
+	ui = app;
+	sent = app;
+}
+
+/*
+Start a UI frame on the main thread: queued input goes to ImGui and the backends read the
+window. Only while no UI frame is being built.
+*/
+void beginUiFrame(UiInputQueue& input)
+{
+	input.replay();
+	ImGui_ImplOpenGL3_NewFrame();
+	ImGui_ImplGlfw_NewFrame();
+}
+
+/*
+Build one UI frame, ImGui::NewFrame() through ImGui::Render(). May run on the UI thread,
+so it touches nothing but "ui", "profiler" and the ImGui context.
+*/
+void buildUi(UiState& ui, Profiler& profiler)
+{
+	ImGuiIO& io = ImGui::GetIO();
+	ImGui::NewFrame();
+
+	// Main menu bar
+	if (ImGui::BeginMainMenuBar())
+	{
+		if (ImGui::BeginMenu("File"))
+		{
+			if (ImGui::MenuItem("Exit"))
+				ui.exit = true;
+
+			ImGui::EndMenu();
+		}
+
+		if (ImGui::BeginMenu("Tools"))
+		{
+			ImGui::MenuItem("Triangle Config", NULL, &ui.showConfigWindow);
+			ImGui::MenuItem("Performance", NULL, &ui.showPerformanceWindow);
+
+			ImGui::MenuItem("Idle when static", NULL, &ui.enableIdle);
+			ImGui::SetItemTooltip("Wait for input instead of redrawing when nothing animates");
+
+			ImGui::MenuItem("Pipelined UI", NULL, &ui.pipelined);
+			ImGui::SetItemTooltip("Build the next UI frame on a worker thread while this one draws");
+
+			if (ImGui::BeginMenu("Swap interval"))
+			{
+				for (int mode = SWAP_VSYNC; mode <= SWAP_UNCAPPED; mode++)
+				{
+					if (ImGui::MenuItem(swapModeNames[mode], NULL, ui.swapMode == mode))
+						ui.swapMode = (SwapMode)mode;
+				}
+
+				ImGui::EndMenu();
+			}
+			ImGui::Separator();
+			ImGui::MenuItem("Demo window", NULL, &ui.showDemoWindow);
+
+			ImGui::EndMenu();
+		}
+
+		if (ui.enableIdle)
+			ImGui::TextDisabled("Idle: %u frames skipped", ui.framesSkipped);
+		if (ui.pipelined)
+			ImGui::TextDisabled("UI thread: %.2f ms", ui.uiBuildMs);
+
+		ImGui::EndMainMenuBar();
+	}
+
+	/* Show/Unshow window for triangle configuration */
+	if (ui.showConfigWindow)
+	{
+		ImGui::Begin("Triangle Config", &ui.showConfigWindow);
+
+		// Color picker
+		if (ImGui::CollapsingHeader("Color"))
+		{
+			ImGuiColorEditFlags tColorPickerFlags = 0;
+			tColorPickerFlags |= ImGuiColorEditFlags_DisplayRGB;
+			tColorPickerFlags |= ImGuiColorEditFlags_DisplayHSV;
+			tColorPickerFlags |= ImGuiColorEditFlags_PickerHueWheel;
+			tColorPickerFlags |= ImGuiColorEditFlags_NoSidePreview;
+
+			ImGui::Checkbox("Animate", &ui.animate);
+			ImGui::SetItemTooltip("Enable/Disable a wave color animation on the triangle");
+			ImGui::SameLine();
+			ImGui::RadioButton("GPU", (int*)&ui.animationMode, COLOR_ANIM_GPU);
+			ImGui::SetItemTooltip("The vertex shader computes the colors from uTime");
+			ImGui::SameLine();
+			ImGui::RadioButton("CPU", (int*)&ui.animationMode, COLOR_ANIM_CPU);
+			ImGui::SetItemTooltip("hsv2rgb on the CPU, the colors are streamed with the instances");
+
+			ImGui::ColorPicker3("Triangle Color", (float*)&ui.colors, tColorPickerFlags);
+
+			ImGui::PlotHistogram("RGB graph", (float*)&ui.colors, 3,
+				0, NULL, 0.0f, 1.0f, ImVec2(0, 75.0f));
+		}
+
+		// Triangle position
+		if (ImGui::CollapsingHeader("Position"))
+		{
+			ImGui::Text("You can move the triangle by pressing WASD/Arrow keys.");
+
+			ImGui::Text("X: %.2f\tY: %.2f", ui.position[0], ui.position[1]);
+
+			if (ImGui::ArrowButton("Left", ImGuiDir_Left))
+			{
+				ui.nudge[0] -= 0.01f;
+			}
+			ImGui::SameLine();
+			if (ImGui::ArrowButton("Up", ImGuiDir_Up))
+			{
+				ui.nudge[1] += 0.01f;
+			}
+			ImGui::SameLine();
+			if (ImGui::ArrowButton("Down", ImGuiDir_Down))
+			{
+				ui.nudge[1] -= 0.01f;
+			}
+			ImGui::SameLine();
+			if (ImGui::ArrowButton("Right", ImGuiDir_Right))
+			{
+				ui.nudge[0] += 0.01f;
+			}
+
+			if (ImGui::Button("Reset", ImVec2(50, 25)))
+			{
+				ui.resetPosition = true;
+			}
+
+			ImGui::SliderInt("Simulation rate", &ui.simulationHz, 10, 1000, "%d Hz", ImGuiSliderFlags_Logarithmic);
+			if (ui.simulationHz < 1)
+				ui.simulationHz = 1;
+			ImGui::Text("%d simulation steps this frame", ui.simulationSteps);
+		}
+
+		// Shader status
+		if (ImGui::CollapsingHeader("Shader"))
+		{
+			switch (ui.shaderStatus)
+			{
+			case SHADER_READY:
+				ImGui::TextColored(ImVec4(0.4f, 1.0f, 0.4f, 1.0f), "Ready");
+				break;
+			case SHADER_COMPILING:
+				ImGui::TextColored(ImVec4(1.0f, 1.0f, 0.4f, 1.0f), "Compiling...");
+				break;
+			case SHADER_FAILED:
+				ImGui::TextColored(ImVec4(1.0f, 0.4f, 0.4f, 1.0f), "Failed, using the last good program");
+				break;
+			}
+
+			ImGui::SameLine();
+			if (ImGui::SmallButton("Reload"))
+				ui.reloadShader = true;
+			ImGui::SetItemTooltip("The shader files are also reloaded automatically when saved");
+
+			if (!ui.shaderLog.empty())
+				ImGui::TextWrapped("%s", ui.shaderLog.c_str());
+		}
+
+		// Triangle instancing
+		if (ImGui::CollapsingHeader("Instances"))
+		{
+			if (ImGui::SliderInt("Triangle count", &ui.triangleCount, 1, MAX_TRIANGLE_COUNT, "%d", ImGuiSliderFlags_Logarithmic))
+			{
+				if (ui.triangleCount < 1)
+					ui.triangleCount = 1;
+				if (ui.triangleCount > MAX_TRIANGLE_COUNT)
+					ui.triangleCount = MAX_TRIANGLE_COUNT;
+			}
+			ImGui::SetItemTooltip("Number of triangles drawn with a single instanced draw call");
+			ImGui::Checkbox("Drift", &ui.drift);
+			ImGui::SetItemTooltip("Move every triangle by its own velocity, bouncing off the border");
+
+			ImGui::Text("Culling:");
+			ImGui::SameLine();
+			ImGui::RadioButton("Off", (int*)&ui.cullMode, CULL_OFF);
+			ImGui::SameLine();
+			ImGui::BeginDisabled(!ui.cullSupported);
+			ImGui::RadioButton("GPU##cull", (int*)&ui.cullMode, CULL_GPU);
+			ImGui::SetItemTooltip(ui.cullSupported ? "A compute pass culls and feeds an indirect draw"
+				: "Needs GL 4.3 compute shaders");
+			ImGui::EndDisabled();
+			ImGui::SameLine();
+			ImGui::RadioButton("CPU##cull", (int*)&ui.cullMode, CULL_CPU);
+			ImGui::SetItemTooltip("The job system culls while writing the instances");
+			if (ui.cullMode != CULL_OFF)
+			{
+				ImGui::SliderFloat("Min size", &ui.cullMinPixels, 0.0f, 16.0f, "%.1f px");
+				ImGui::SetItemTooltip("Triangles smaller than this on screen are culled");
+			}
+
+			ImGui::Text("%d triangles, %u draws in %u calls (%s)", ui.triangleCount, ui.batchStats.draws,
+				ui.batchStats.calls, ui.batchStats.multiDraw ? "multi draw indirect" : "one call per draw");
+			if (ui.cullMode != CULL_OFF)
+				ImGui::Text("Drawn: %zu, culled: %zu", ui.drawnCount, ui.culledCount);
+			ImGui::Text("%.3f ms/frame (%.1f FPS)", 1000.0f / io.Framerate, io.Framerate);
+
+			const StreamBufferStats& streamStats = ui.streamStats;
+			ImGui::Text("Streamed: %.1f KB/frame, %.1f MB total (%s)", streamStats.bytesLastFrame / 1024.0f,
+				streamStats.bytesTotal / (1024.0 * 1024.0), streamStats.persistent ? "persistent map" : "map range");
+			ImGui::Text("Fence wait: %.3f ms, %.1f ms total, %u stalls", streamStats.fenceWaitMs,
+				streamStats.fenceWaitTotalMs, streamStats.fenceStalls);
+			ImGui::Text("Uniform uploads: %u, skipped: %u", ui.uniformUploads, ui.uniformSkips);
+		}
+
+		// Triangle picked with the mouse
+		if (ImGui::CollapsingHeader("Selection"))
+		{
+			if (ui.selected < 0)
+			{
+				ImGui::TextWrapped("Click a triangle to select it");
+			}
+			else
+			{
+				const SceneEntity& entity = ui.selectedEntity;
+				ImGui::Text("Triangle %lld", ui.selected);
+				ImGui::Text("X: %.3f\tY: %.3f", entity.position[0], entity.position[1]);
+				ImGui::Text("Velocity: %.3f, %.3f", entity.velocity[0], entity.velocity[1]);
+				ImGui::ColorButton("Tint", ImVec4(entity.tint[0], entity.tint[1], entity.tint[2], 1.0f));
+				ImGui::SameLine();
+				ImGui::Text("Tint: %.2f, %.2f, %.2f", entity.tint[0], entity.tint[1], entity.tint[2]);
+				ImGui::Text("Hue phase: %.3f", entity.phase);
+			}
+
+			const PickStats& pickStats = ui.pickStats;
+			ImGui::Text("Pick grid: %zu cells, built in %.1f ms", pickStats.cells, pickStats.buildMs);
+			ImGui::Text("Update: %.2f ms", pickStats.updateMs);
+		}
+
+		// Mesh streamed from a file
+		if (ImGui::CollapsingHeader("Mesh"))
+		{
+			const MeshLoadStats& meshStats = ui.meshStats;
+			if (ui.meshPath.empty())
+			{
+				ImGui::TextWrapped("No mesh, start with --mesh file.tcm to load one");
+			}
+			else
+			{
+				ImGui::Text("%s, %llu triangles", ui.meshPath.c_str(), meshStats.triangleCount);
+				ImGui::ProgressBar(ui.meshProgress);
+				ImGui::Text("%.1f of %.1f MB in %d frames", meshStats.bytesUploaded / (1024.0 * 1024.0),
+					meshStats.bytesTotal / (1024.0 * 1024.0), meshStats.frames);
+				ImGui::Text("Upload: %.1f MB/s, overall %.1f MB/s", meshUploadRate(meshStats), meshOverallRate(meshStats));
+				ImGui::Text("Peak RSS: %.1f MB", meshStats.peakResident / (1024.0 * 1024.0));
+			}
+		}
+
+		// What drawing the UI took last frame
+		if (ImGui::CollapsingHeader("Interface"))
+		{
+			const ImGui_ImplOpenGL3_RenderStats& renderStats = ui.uiRenderStats;
+			ImGui::Text("Draw calls: %d", renderStats.DrawCalls);
+			ImGui::Text("Texture binds: %d, scissor changes: %d", renderStats.TextureBinds, renderStats.ScissorChanges);
+			ImGui::Text("Uploaded: %.1f KB", renderStats.BytesUploaded / 1024.0);
+		}
+
+		ImGui::End();
+	}
+
+	// Performance window
+	if (ui.showPerformanceWindow)
+		profiler.showWindow(&ui.showPerformanceWindow);
+
+	// Demo window
+	if (ui.showDemoWindow)
+		ImGui::ShowDemoWindow(&ui.showDemoWindow);
+
+	// The cursor picks triangles unless a window has it
+	ui.sceneHovered = !io.WantCaptureMouse && ImGui::IsMousePosValid() && io.DisplaySize.x > 0.0f && io.DisplaySize.y > 0.0f;
+	if (ui.sceneHovered)
+	{
+		ui.mouse[0] = 2.0f * io.MousePos.x / io.DisplaySize.x - 1.0f;
+		ui.mouse[1] = 1.0f - 2.0f * io.MousePos.y / io.DisplaySize.y;
+		if (ImGui::IsMouseClicked(ImGuiMouseButton_Left))
+			ui.sceneClicked = true;
+		if (ui.hovered >= 0)
+			ImGui::SetTooltip("Triangle %lld", ui.hovered);
+	}
+
+	// Anything being hovered or used keeps the app from going idle
+	ui.interacting = ImGui::IsAnyItemActive() || ImGui::IsAnyItemHovered() || ImGui::IsAnyMouseDown() || io.WantTextInput;
+
+	ImGui::Render();
+}
+
 int main(int argc, char** argv)
 {
+	AppOptions options;
+	if (!parseOptions(argc, argv, options))
+		return -1;
+
+	// Benchmarks of the CPU side only, no window or context needed
+	if (options.bench == "hsv")
+	{
+		benchmarkHsv2rgb(HSV_BENCH_COUNT);
+		return 0;
+	}
+	if (options.bench == "jobs")
+	{
+		benchmarkJobs(options.threads);
+		return 0;
+	}
+	if (options.bench == "scene")
+	{
+		benchmarkScene(options.threads);
+		return 0;
+	}
+	if (options.bench == "pick")
+		return benchmarkPick(options.threads) ? 0 : -1;
+
+	// Checks, exit with -1 if one fails
+	if (options.test == "jobs")
+		return testJobs(options.threads) ? 0 : -1;
+
+	if (options.makeMeshTriangles > 0)
+	{
+		if (!writeTestMesh(options.meshPath, options.makeMeshTriangles))
+		{
+			printf("Failed to write %s\n", options.meshPath.c_str());
+			return -1;
+		}
+
+		printf("Wrote %llu triangles to %s\n", options.makeMeshTriangles, options.meshPath.c_str());
+		return 0;
+	}
+
 	// Init
+	logSetLevel(options.logLevel);
+	logStart();
+
+	// Shared by everything that runs in parallel, the main thread helps while it waits
+	JobSystem jobs(options.threads > 0 ? options.threads - 1 : -1);
+
+	// Rasterize the fonts while the window and context are created. The atlas is built
+	// before there is an ImGui context, so the job shares nothing with the main thread.
+	ImFontAtlas* fontAtlas = NULL;
+	JobHandle fontJob = jobs.submit([&fontAtlas]()
+	{
+		fontAtlas = IM_NEW(ImFontAtlas)();
+		fontAtlas->AddFontDefault();
+		fontAtlas->Build();
+	});
+
+	// Headless runs don't need a display at all when GLFW has the null platform (3.4+)
+#ifdef GLFW_PLATFORM_NULL
+	if (options.headless)
+		glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+#endif
 	glfwInit();
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, GLFW_VERSION_MAJOR);
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, GLFW_VERSION_MINOR);
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 
+	if (options.headless)
+	{
+		glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+#ifndef _WIN32
+		// Software rendering through OSMesa (Mesa llvmpipe), no GPU or display server needed
+		glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_OSMESA_CONTEXT_API);
+#endif
+	}
+
 	GLFWwindow* window = glfwCreateWindow(SCREEN_WIDTH, SCREEN_HEIGHT, APP_TITLE, NULL, NULL);
+	if (window == NULL && options.headless)
+	{
+		// No OSMesa, fall back to a hidden window on the native context API
+		glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_NATIVE_CONTEXT_API);
+		window = glfwCreateWindow(SCREEN_WIDTH, SCREEN_HEIGHT, APP_TITLE, NULL, NULL);
+	}
 	if (window == NULL)
 	{
-		printf("ERROR. Failed to create window.\n");
+		LOG_ERROR("Failed to create window.");
+		logStop();
 		return -1;
 	}
 	glfwMakeContextCurrent(window);
-	glfwSwapInterval(1);
+	applySwapMode(options.swapMode);
 
 	if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
 	{
-		printf("ERROR. Failed to initialize GLAD.\n");
+		LOG_ERROR("Failed to initialize GLAD.");
+		logStop();
 		return -1;
 	}
+	loadGLExtensions((GLADloadproc)glfwGetProcAddress);
 
 	glViewport(0, 0, SCREEN_WIDTH, SCREEN_HEIGHT);
 	glfwSetFramebufferSizeCallback(window, frameBufferSizeCallback);
+	glfwSetWindowRefreshCallback(window, windowRefreshCallback);
 
 	IMGUI_CHECKVERSION();
-	ImGui::CreateContext();
+	jobs.wait(fontJob);
+	ImGui::CreateContext(fontAtlas);
 	ImGuiIO& io = ImGui::GetIO(); (void)io;
 	io.ConfigFlags |= ImGuiConfigFlags_NavEnableKeyboard;
 
+	// Don't let a saved window layout change the output of headless runs
+	if (options.headless)
+		io.IniFilename = NULL;
+
 	ImGui::StyleColorsDark();
 
-	ImGui_ImplGlfw_InitForOpenGL(window, true);
-	ImGui_ImplOpenGL3_Init(GLSL_VERSION);
+	// Input reaches ImGui through a queue, it can't write into a UI frame being built on the worker
+	ImGui_ImplGlfw_InitForOpenGL(window, false);
+	// A single context, every window's draw list uploaded in one go each frame and clipped in the shader
+	// so commands merge into fewer draws, and the render loop sets the GL state it needs itself, so the
+	// backend doesn't back it up and restore it
+	ImGui_ImplOpenGL3_Init(GLSL_VERSION, ImGui_ImplOpenGL3_Flags_SingleUpload | ImGui_ImplOpenGL3_Flags_ShaderClip |
+		ImGui_ImplOpenGL3_Flags_AppOwnsState);
+	UiInputQueue uiInput;
+	uiInput.install(window);
+
+	// Offscreen target for headless runs, everything is drawn into it instead of the window
+	GLuint headlessFBO = 0, headlessRBO = 0;
+	if (options.headless)
+	{
+		glGenRenderbuffers(1, &headlessRBO);
+		glBindRenderbuffer(GL_RENDERBUFFER, headlessRBO);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, SCREEN_WIDTH, SCREEN_HEIGHT);
+
+		glGenFramebuffers(1, &headlessFBO);
+		glBindFramebuffer(GL_FRAMEBUFFER, headlessFBO);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, headlessRBO);
+
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		{
+			LOG_ERROR("Failed to create the offscreen framebuffer.");
+			logStop();
+			return -1;
+		}
+	}
 
 	// Triangle
-	float vertices[] = {
-		// Position				// Color
-		 0.0f,  0.5f, 0.0f,		1.0f, 0.0f, 0.0f,		// Head
-		-0.5f, -0.5f, 0.0f,		0.0f, 1.0f, 0.0f,		// Left foot
-		 0.5f, -0.5f, 0.0f,		0.0f, 0.0f, 1.0f		// Right foot
+	MeshVertex vertices[] = {
+		// Position					// Color
+		{ {  0.0f,  0.5f, 0.0f },	{ 1.0f, 0.0f, 0.0f } },		// Head
+		{ { -0.5f, -0.5f, 0.0f },	{ 0.0f, 1.0f, 0.0f } },		// Left foot
+		{ {  0.5f, -0.5f, 0.0f },	{ 0.0f, 0.0f, 1.0f } }		// Right foot
 	};
+	unsigned int indices[] = { 0, 1, 2 };
+
+	// The scene is generated while the shader compiles, GL calls stay on this thread
+	int triangleCount = options.triangleCount;
+	Scene scene;
+	PickGrid pickGrid(jobs);
+	// The pick grid is sorted only when something picks, so drift alone doesn't pay for it
+	bool pickGridStale = true;
+	JobHandle sceneJob = jobs.submit([&scene, triangleCount]()
+	{
+		scene.resize(triangleCount);
+	});
 
-	// Shaders
-	Shader tShader("TriangleVertex.glsl", "TriangleFragment.glsl");
+	// Every mesh goes through the batcher, the triangle is one too
+	DrawBatcher batcher;
+	unsigned int triangleMesh = batcher.addMesh(3, 3);
+	batcher.uploadVertices(triangleMesh, 0, vertices, 3);
+	batcher.uploadIndices(triangleMesh, 0, indices, 3);
 
-	// Buffers
-	GLuint VBO, VAO;
-	glGenBuffers(1, &VBO);
-	glGenVertexArrays(1, &VAO);
+	// Shaders, every variant the app can switch to is built up front. Multi draws read
+	// the position and scale per draw, that takes its own vertex shader.
+	const char* triangleVertexPath = batcher.isMultiDraw() ? "BatchVertex.glsl" : "TriangleVertex.glsl";
+	// Reloads are read and compiled on a thread with a shared context, frames never wait for them
+	ShaderCompiler shaderCompiler;
+	shaderCompiler.start(window);
+	ShaderLibrary shaders;
+	shaders.setCompiler(&shaderCompiler);
+	double shaderStart = glfwGetTime();
+	Shader* plainShader = shaders.get(triangleVertexPath, "TriangleFragment.glsl");
+	double plainShaderEnd = glfwGetTime();
+	Shader* animatedShader = shaders.get(triangleVertexPath, "TriangleFragment.glsl", { "GPU_ANIM" });
+	LOG_INFO("Triangle shader %s in %.2f ms, GPU_ANIM variant %s in %.2f ms",
+		plainShader->isFromBinaryCache() ? "loaded from binary cache" : "compiled", (plainShaderEnd - shaderStart) * 1000.0,
+		animatedShader->isFromBinaryCache() ? "loaded from binary cache" : "compiled", (glfwGetTime() - plainShaderEnd) * 1000.0);
 
-	glBindVertexArray(VAO);
-	glBindBuffer(GL_ARRAY_BUFFER, VBO);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+	// Instance culling, the CPU does it if there are no compute shaders
+	InstanceCuller culler;
+	CullMode cullMode = options.cullMode;
+	bool cullSupported = culler.init(shaders);
+	if (cullMode == CULL_GPU && !cullSupported)
+	{
+		LOG_WARNING("No GPU culling without GL 4.3 compute shaders, culling on the CPU instead");
+		cullMode = CULL_CPU;
+	}
+	float cullMinPixels = CULL_DEFAULT_MIN_PIXELS;
+	size_t drawnCount = 0;
+	size_t culledCount = 0;
+
+	// Mouse picking, against the triangles as the last frame drew them
+	long long hoveredTriangle = -1;
+	long long selectedTriangle = -1;
+	float drawnPosition[] = { 0.0f, 0.0f };
+	float drawnAlpha = 1.0f;
 
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (GLvoid*)0);
-	glEnableVertexAttribArray(0);
+	// Recompile the shaders when one of their files is saved
+	FileWatcher shaderWatcher;
+	shaderWatcher.setCallback([]() { glfwPostEmptyEvent(); });
+	for (const string& file : shaders.getFiles())
+		shaderWatcher.watch(file);
+	for (const string& file : culler.getFiles())
+		shaderWatcher.watch(file);
 
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (GLvoid*)(3 * sizeof(float)));
-	glEnableVertexAttribArray(1);
-	glBindVertexArray(0);
+	// Instance data, streamed every frame and handed to the batcher when drawing
+	jobs.wait(sceneJob);
+
+	StreamBuffer instanceStream(GL_ARRAY_BUFFER, instanceSlotSize(scene.size()));
+
+	// Mesh, streamed in over the next frames
+	Mesh mesh;
+	if (!options.meshPath.empty())
+	{
+		string meshError;
+		if (mesh.load(options.meshPath, batcher, meshError))
+			LOG_INFO("Loading mesh %s, %llu triangles", options.meshPath.c_str(), mesh.getStats().triangleCount);
+		else
+			LOG_ERROR("%s", meshError.c_str());
+	}
 
 	// Triangle config
 	// Triangle color 
 	ImVec4 colors = ImVec4(1.0f, 0.3f, 0.1f, 1.0f);
 	// Triangle position
 	float position[] = { 0.0f, 0.0f, 0.0f };
+	// Triangle position at the previous simulation step, rendering blends between the two
+	float previousPosition[] = { 0.0f, 0.0f, 0.0f };
 
-	// Uniform location for "uColor"
-	int tColor = glGetUniformLocation(tShader.ID, "uColor");
-	// Uniform location for "uPos"
-	int tPos = glGetUniformLocation(tShader.ID, "uPos");
+	// Fixed timestep simulation
+	SwapMode swapMode = options.swapMode;
+	int simulationHz = options.simulationHz;
+	double simulationAccumulator = 0.0;
+	double lastFrameTime = glfwGetTime();
+	int simulationSteps = 0;
 
 	// ImGui config
-	// Enable/Disable demo window, self-explanatory
-	bool showDemoWindow = false;
-	// Enable/Disable triangle configuration window
-	bool showConfigWindow = true;
 	// Enable/Disable triangle color animation cycle
-	bool enableTriangleColorAnim = false;
+	bool enableTriangleColorAnim = options.animate;
+	ColorAnimationMode colorAnimationMode = options.animationMode;
+	// Enable/Disable the triangles moving on their own
+	bool enableDrift = options.drift;
+	// Enable/Disable waiting for events instead of redrawing when nothing changes
+	bool enableIdle = !options.headless;
+	// Frames in a row where nothing moved, and frames not drawn while idle
+	int idleFrames = 0;
+	unsigned int framesSkipped = 0;
 
-	while (!glfwWindowShouldClose(window))
+	// Per-phase CPU/GPU timings
+	Profiler profiler;
+	profiler.init();
+
+	// The UI's copy of the app state, see UiState
+	UiState ui = {};
+	ui.colors = colors;
+	ui.animate = enableTriangleColorAnim;
+	ui.animationMode = colorAnimationMode;
+	ui.simulationHz = simulationHz;
+	ui.triangleCount = triangleCount;
+	ui.drift = enableDrift;
+	ui.cullMode = cullMode;
+	ui.cullMinPixels = cullMinPixels;
+	ui.swapMode = swapMode;
+	ui.enableIdle = enableIdle;
+	ui.pipelined = options.pipelinedUi;
+	ui.showConfigWindow = true;
+	ui.hovered = -1;
+	ui.selected = -1;
+	UiState uiSent = ui;
+	// The Performance window draws from a copy of the history
+	Profiler uiProfiler;
+
+	bool pipelinedUi = options.pipelinedUi;
+	UiPipeline uiPipeline([&ui, &uiProfiler]() { buildUi(ui, uiProfiler); });
+	uiPipeline.setThreaded(pipelinedUi);
+
+	bool uiInteracting = false;
+	bool exitRequested = false;
+
+	// The variant drawing the triangles, the GPU animation has its own. Culled instances
+	// come with their animated tints, they're drawn with the plain one.
+	auto triangleShader = [&]() -> Shader&
 	{
-		float timeVal = (float)glfwGetTime();
+		return (enableTriangleColorAnim && colorAnimationMode == COLOR_ANIM_GPU && cullMode == CULL_OFF)
+			? *animatedShader : *plainShader;
+	};
 
-		// Input
-		if (GLFW_PRESS == (glfwGetKey(window, GLFW_KEY_W) | glfwGetKey(window, GLFW_KEY_UP)))
+	// Apply what the UI changed and refresh its copy, only while no UI frame is being built
+	auto syncUi = [&]()
+	{
+		int previousCount = triangleCount;
+		SwapMode previousSwapMode = swapMode;
+
+		syncSetting(colors, ui.colors, uiSent.colors);
+		syncSetting(enableTriangleColorAnim, ui.animate, uiSent.animate);
+		syncSetting(colorAnimationMode, ui.animationMode, uiSent.animationMode);
+		syncSetting(simulationHz, ui.simulationHz, uiSent.simulationHz);
+		syncSetting(triangleCount, ui.triangleCount, uiSent.triangleCount);
+		syncSetting(enableDrift, ui.drift, uiSent.drift);
+		syncSetting(cullMode, ui.cullMode, uiSent.cullMode);
+		syncSetting(cullMinPixels, ui.cullMinPixels, uiSent.cullMinPixels);
+		syncSetting(swapMode, ui.swapMode, uiSent.swapMode);
+		syncSetting(enableIdle, ui.enableIdle, uiSent.enableIdle);
+		syncSetting(pipelinedUi, ui.pipelined, uiSent.pipelined);
+
+		if (triangleCount != previousCount)
 		{
-			position[1] += 0.01f;
+			scene.resize(triangleCount);
+			pickGridStale = true;
+			instanceStream.resize(instanceSlotSize(scene.size()));
+			selectedTriangle = -1;
 		}
-		if (GLFW_PRESS == (glfwGetKey(window, GLFW_KEY_A) | glfwGetKey(window, GLFW_KEY_LEFT)))
+		if (swapMode != previousSwapMode)
+			applySwapMode(swapMode);
+
+		position[0] += ui.nudge[0];
+		position[1] += ui.nudge[1];
+		ui.nudge[0] = ui.nudge[1] = 0.0f;
+		if (ui.resetPosition)
 		{
-			position[0] -= 0.01f;
+			position[0] = 0.0f;
+			position[1] = 0.0f;
+			memcpy(previousPosition, position, sizeof(position));
+			ui.resetPosition = false;
 		}
-		if (GLFW_PRESS == (glfwGetKey(window, GLFW_KEY_S) | glfwGetKey(window, GLFW_KEY_DOWN)))
+		if (ui.reloadShader)
+		{
+			shaders.reload();
+			culler.init(shaders);
+			ui.reloadShader = false;
+		}
+		exitRequested = ui.exit;
+
+		// Pick with the scene position taken off, a click on nothing clears the selection
+		hoveredTriangle = -1;
+		if (ui.sceneHovered)
 		{
-			position[1] -= 0.01f;
+			if (pickGridStale)
+			{
+				pickGrid.update(scene);
+				pickGridStale = false;
+			}
+			hoveredTriangle = pickGrid.pick(ui.mouse[0] - drawnPosition[0], ui.mouse[1] - drawnPosition[1],
+				triangleScale(triangleCount), drawnAlpha);
 		}
-		if (GLFW_PRESS == (glfwGetKey(window, GLFW_KEY_D) | glfwGetKey(window, GLFW_KEY_RIGHT)))
+		if (ui.sceneClicked)
 		{
-			position[0] += 0.01f;
+			selectedTriangle = hoveredTriangle;
+			ui.sceneClicked = false;
 		}
 
-		glClearColor(0.1f, 0.2f, 0.3f, 1.0f);
-		glClear(GL_COLOR_BUFFER_BIT);
+		ui.position[0] = position[0];
+		ui.position[1] = position[1];
+		ui.simulationSteps = simulationSteps;
+		ui.framesSkipped = framesSkipped;
+		ui.shaderStatus = triangleShader().getStatus();
+		ui.shaderLog = triangleShader().getErrorLog();
+		ui.streamStats = instanceStream.getStats();
+		ui.uniformUploads = triangleShader().getUniformUploads();
+		ui.uniformSkips = triangleShader().getUniformSkips();
+		ui.uiBuildMs = uiPipeline.getBuildMs();
+		ui.uiRenderStats = ImGui_ImplOpenGL3_GetRenderStats();
+		ui.batchStats = batcher.getStats();
+		ui.cullSupported = cullSupported;
+		ui.drawnCount = drawnCount;
+		ui.culledCount = culledCount;
+		ui.meshPath = mesh.getPath();
+		ui.meshStats = mesh.getStats();
+		ui.meshProgress = mesh.getProgress();
+		ui.hovered = hoveredTriangle;
+		ui.selected = selectedTriangle;
+		if (selectedTriangle >= 0)
+			ui.selectedEntity = scene.getEntity((size_t)selectedTriangle, drawnAlpha);
+		ui.pickStats = pickGrid.getStats();
+		if (ui.showPerformanceWindow)
+			uiProfiler.copyHistory(profiler);
+
+		uiInteracting = ui.interacting;
+	};
 
-		// UI
-		ImGui_ImplOpenGL3_NewFrame();
-		ImGui_ImplGlfw_NewFrame();
-		ImGui::NewFrame();
+	int frameCount = 0;
+	double runStart = glfwGetTime();
 
-		// Main menu bar
-		if (ImGui::BeginMainMenuBar())
+	while (!glfwWindowShouldClose(window))
+	{
+		// Idle, sleep until an event arrives instead of drawing the same frame again
+		if (idleFrames > IDLE_GRACE_FRAMES)
 		{
-			if (ImGui::BeginMenu("File"))
-			{
-				if (ImGui::MenuItem("Exit"))
-					break;
+			glfwWaitEventsTimeout(IDLE_WAIT_TIMEOUT);
 
-				ImGui::EndMenu();
+			if (!uiInput.pending() && !redrawRequested && !shaderWatcher.pending())
+			{
+				framesSkipped++;
+				continue;
 			}
 
-			if (ImGui::BeginMenu("Tools"))
-			{
-				ImGui::MenuItem("Triangle Config", NULL, &showConfigWindow);
-				ImGui::Separator();
-				ImGui::MenuItem("Demo window", NULL, &showDemoWindow);
+			// Nothing moved while idle, don't make the simulation catch up on it
+			idleFrames = 0;
+			lastFrameTime = glfwGetTime();
+		}
+		redrawRequested = false;
 
-				ImGui::EndMenu();
-			}
+		float timeVal = (float)glfwGetTime();
+
+		profiler.beginFrame();
 
-			ImGui::EndMainMenuBar();
+		// Shader hot reload, the old program stays in use until the new one has linked
+		if (shaderWatcher.poll())
+		{
+			shaders.reload();
+			culler.init(shaders);
 		}
+		shaders.update();
+
+		// Input
+		profiler.beginCpu(PHASE_INPUT);
+		SimulationInput input;
+		input.up = GLFW_PRESS == (glfwGetKey(window, GLFW_KEY_W) | glfwGetKey(window, GLFW_KEY_UP));
+		input.left = GLFW_PRESS == (glfwGetKey(window, GLFW_KEY_A) | glfwGetKey(window, GLFW_KEY_LEFT));
+		input.down = GLFW_PRESS == (glfwGetKey(window, GLFW_KEY_S) | glfwGetKey(window, GLFW_KEY_DOWN));
+		input.right = GLFW_PRESS == (glfwGetKey(window, GLFW_KEY_D) | glfwGetKey(window, GLFW_KEY_RIGHT));
+		profiler.endCpu(PHASE_INPUT);
 
-		/* Show/Unshow window for triangle configuration */
-		if (showConfigWindow)
+		// Simulation, runs at a fixed rate no matter how fast frames are rendered
+		profiler.beginCpu(PHASE_SIMULATION);
+		double now = glfwGetTime();
+		simulationAccumulator += fmin(now - lastFrameTime, SIMULATION_MAX_FRAME_TIME);
+		lastFrameTime = now;
+
+		double simulationDt = 1.0 / simulationHz;
+		simulationSteps = 0;
+		while (simulationAccumulator >= simulationDt)
 		{
-			ImGui::Begin("Triangle Config", &showConfigWindow);
+			memcpy(previousPosition, position, sizeof(position));
+			simulateStep(position, input, (float)simulationDt);
+			if (enableDrift)
+				scene.step((float)simulationDt, jobs);
+			simulationAccumulator -= simulationDt;
+			simulationSteps++;
+		}
 
-			// Color picker
-			if (ImGui::CollapsingHeader("Color"))
-			{
-				ImGuiColorEditFlags tColorPickerFlags;
-				tColorPickerFlags |= ImGuiColorEditFlags_DisplayRGB;
-				tColorPickerFlags |= ImGuiColorEditFlags_DisplayHSV;
-				tColorPickerFlags |= ImGuiColorEditFlags_PickerHueWheel;
-				tColorPickerFlags |= ImGuiColorEditFlags_NoSidePreview;
-
-				ImGui::Checkbox("Animate", &enableTriangleColorAnim);
-				ImGui::SetItemTooltip("Enable/Disable a wave color animation on the triangle");
-
-				ImGui::ColorPicker3("Triangle Color", (float*)&colors, tColorPickerFlags);
-				
-				ImGui::PlotHistogram("RGB graph", (float*)&colors, 3,
-					0, NULL, 0.0f, 1.0f, ImVec2(0, 75.0f));
-			}
+		// Picking sorts the triangles again before it next runs
+		if (enableDrift && simulationSteps > 0)
+			pickGridStale = true;
+		profiler.endCpu(PHASE_SIMULATION);
 
-			// Triangle position
-			if (ImGui::CollapsingHeader("Position"))
-			{
-				ImGui::Text("You can move the triangle by pressing WASD/Arrow keys.");
+		// UI. Serial it's built right here and its changes apply to this frame. Pipelined the
+		// worker builds the next UI frame while this one draws, so the UI runs a frame behind.
+		profiler.beginCpu(PHASE_UI_BUILD);
+		if (uiPipeline.isThreaded())
+		{
+			uiPipeline.wait();
+			syncUi();
+			beginUiFrame(uiInput);
+			uiPipeline.kick();
+		}
+		else
+		{
+			beginUiFrame(uiInput);
+			uiPipeline.kick();
+			syncUi();
+		}
+		profiler.endCpu(PHASE_UI_BUILD);
 
-				ImGui::Text("X: %.2f\tY: %.2f", position[0], position[1]);
+		if (exitRequested)
+			break;
 
-				if (ImGui::ArrowButton("Left", ImGuiDir_Left)) 
-				{
-					position[0] -= 0.01f;
-				}
-				ImGui::SameLine();
-				if (ImGui::ArrowButton("Up", ImGuiDir_Up)) 
-				{
-					position[1] += 0.01f;
-				}
-				ImGui::SameLine();
-				if (ImGui::ArrowButton("Down", ImGuiDir_Down)) 
-				{
-					position[1] -= 0.01f;
-				}
-				ImGui::SameLine();
-				if (ImGui::ArrowButton("Right", ImGuiDir_Right)) 
-				{
-					position[0] += 0.01f;
-				}
+		profiler.beginCpu(PHASE_SCENE);
+		profiler.beginGpu(PHASE_SCENE);
 
-				if (ImGui::Button("Reset", ImVec2(50, 25)))
-				{
-					position[0] = 0.0f;
-					position[1] = 0.0f;
-				}
-			}
-				
-			ImGui::End();
+		// Border check, the arrow buttons move the triangle outside of simulation steps
+		clampToBorder(position);
+
+		// Count quiet frames, anything animating or being interacted with keeps us awake
+		bool moving = memcmp(previousPosition, position, sizeof(position)) != 0;
+		bool keysHeld = input.up || input.left || input.down || input.right;
+		if (!enableIdle || enableTriangleColorAnim || enableDrift || moving || uiInteracting || keysHeld
+			|| shaders.isCompiling() || mesh.isLoading())
+			idleFrames = 0;
+		else
+			idleFrames++;
+
+		// Blend between the last two simulation steps by how far we are into the next one
+		float alpha = (float)(simulationAccumulator / simulationDt);
+		float renderPosition[] = {
+			previousPosition[0] + (position[0] - previousPosition[0]) * alpha,
+			previousPosition[1] + (position[1] - previousPosition[1]) * alpha
+		};
+
+		// The UI leaves its GL state behind (ImGui_ImplOpenGL3_Flags_AppOwnsState), set what the scene relies on
+		int viewWidth = SCREEN_WIDTH, viewHeight = SCREEN_HEIGHT;
+		if (options.headless)
+			glBindFramebuffer(GL_FRAMEBUFFER, headlessFBO);
+		else
+			glfwGetFramebufferSize(window, &viewWidth, &viewHeight);
+		glViewport(0, 0, viewWidth, viewHeight);
+		glDisable(GL_SCISSOR_TEST);
+		glDisable(GL_BLEND);
+
+		glClearColor(0.1f, 0.2f, 0.3f, 1.0f);
+		glClear(GL_COLOR_BUFFER_BIT);
+
+		// Next chunks of a mesh being loaded
+		if (mesh.update())
+		{
+			const MeshLoadStats& meshStats = mesh.getStats();
+			LOG_INFO("Mesh loaded in %d frames, %.1f MB/s upload, %.1f MB/s overall", meshStats.frames,
+				meshUploadRate(meshStats), meshOverallRate(meshStats));
 		}
 
-		// Demo window
-		if (showDemoWindow)
-			ImGui::ShowDemoWindow(&showDemoWindow);
+		// What culling keeps: inside the view, and at least cullMinPixels across on the smaller side
+		SceneView view;
+		view.position[0] = renderPosition[0];
+		view.position[1] = renderPosition[1];
+		view.scale = triangleScale(triangleCount);
+		view.minScale = 2.0f * cullMinPixels / fmaxf((float)std::min(viewWidth, viewHeight), 1.0f);
 
-		// If enabled, Calculate RGB color to make a rainbow wave color
-		if (enableTriangleColorAnim)
+		// Stream this frame's instance data
+		instanceStream.beginFrame();
+		GLintptr instanceOffset = 0;
+		size_t instanceCount = scene.size();
+		void* instanceData = instanceStream.allocate(scene.size() * sizeof(TriangleInstance), sizeof(float), instanceOffset);
+		if (instanceData != NULL)
 		{
-			colors = hsv2rgb(ImVec4(sin(timeVal) * 255.0f, 255.0f, 255.0f, 1.0f));
+			// Drifting triangles blend between simulation steps like the scene position does
+			float instanceAlpha = enableDrift ? alpha : 1.0f;
+			drawnAlpha = instanceAlpha;
+
+			// If enabled, tint every triangle with a rainbow wave color, each a bit further along the wheel.
+			// The GPU path only needs the static tints, the vertex shader replaces them.
+			if (cullMode == CULL_CPU)
+				instanceCount = scene.writeVisibleInstances((TriangleInstance*)instanceData, instanceAlpha,
+					enableTriangleColorAnim, colorWave(timeVal), view, jobs);
+			else if (enableTriangleColorAnim && colorAnimationMode == COLOR_ANIM_CPU)
+				scene.writeAnimatedInstances((TriangleInstance*)instanceData, instanceAlpha, colorWave(timeVal), jobs);
+			else
+				scene.writeInstances((TriangleInstance*)instanceData, instanceAlpha, jobs);
 		}
+		instanceStream.flush();
 
-		// Border check
-		if ((position[0]) >= 0.5f)
-			position[0] = 0.5f;
-		if ((position[0]) <= -0.5f)
-			position[0] = -0.5f;
-		if ((position[1]) >= 0.5f)
-			position[1] = 0.5f;
-		if ((position[1]) <= -0.5f)
-			position[1] = -0.5f;
+		// GPU culling reads the slot just written, the survivors are drawn from its own buffer
+		bool gpuCulled = cullMode == CULL_GPU && instanceData != NULL;
+		if (gpuCulled)
+		{
+			culler.cull(instanceStream.ID, instanceOffset, scene.size(), view,
+				enableTriangleColorAnim && colorAnimationMode == COLOR_ANIM_GPU, timeVal);
+			drawnCount = culler.getDrawnCount();
+			culledCount = culler.getCulledCount();
+		}
+		else
+		{
+			drawnCount = instanceCount;
+			culledCount = scene.size() - instanceCount;
+		}
 
 		// Viewport
+		Shader& tShader = triangleShader();
 		tShader.use();
-		glBindVertexArray(VAO);
-		glUniform3f(tColor, colors.x, colors.y, colors.z);
-		glUniform3f(tPos, position[0], position[1], 0.0f);
-		glDrawArrays(GL_TRIANGLES, 0, 3);
-		glBindVertexArray(0);
+		// The animated tints already carry the color
+		if (enableTriangleColorAnim)
+		{
+			// Triangle 0 has no phase offset, its color is the plain wave
+			ImGui::ColorConvertHSVtoRGB(colorWave(timeVal), 1.0f, 1.0f, colors.x, colors.y, colors.z);
+			if (colorAnimationMode == COLOR_ANIM_GPU)
+				tShader.set("uTime", timeVal);
+			tShader.set("uColor", 1.0f, 1.0f, 1.0f);
+		}
+		else
+		{
+			tShader.set("uColor", colors.x, colors.y, colors.z);
+		}
+
+		// The mesh goes under the triangles, at its own size
+		mesh.draw(tShader, renderPosition);
+		drawnPosition[0] = renderPosition[0];
+		drawnPosition[1] = renderPosition[1];
+
+		BatchDraw triangles = {};
+		triangles.position[0] = renderPosition[0];
+		triangles.position[1] = renderPosition[1];
+		triangles.scale = triangleScale(triangleCount);
+		triangles.instanceCount = (unsigned int)instanceCount;
+		if (gpuCulled)
+		{
+			// Only the GPU knows how many survived
+			batcher.setInstanceBuffer(culler.getOutputBuffer(), 0);
+			triangles.countBuffer = culler.getCountBuffer();
+		}
+		else
+		{
+			batcher.setInstanceBuffer(instanceStream.ID, instanceOffset);
+		}
+		if (instanceData != NULL && instanceCount > 0)
+			batcher.add(tShader, triangleMesh, triangles);
+
+		batcher.flush();
+		instanceStream.endFrame();
+		profiler.endGpu(PHASE_SCENE);
+		profiler.endCpu(PHASE_SCENE);
 
 		// Render
-		ImGui::Render();
-		ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+		profiler.beginCpu(PHASE_UI_RENDER);
+		profiler.beginGpu(PHASE_UI_RENDER);
+		ImDrawData* uiDrawData = uiPipeline.getDrawData();
+		if (uiDrawData != NULL)
+			ImGui_ImplOpenGL3_RenderDrawData(uiDrawData);
+		profiler.endGpu(PHASE_UI_RENDER);
+		profiler.endCpu(PHASE_UI_RENDER);
+
+		{
+			ProfilerScope scope(profiler, PHASE_SWAP);
+			glfwSwapBuffers(window);
+		}
+		{
+			ProfilerScope scope(profiler, PHASE_INPUT);
+			glfwPollEvents();
+		}
+
+		profiler.endFrame();
+
+		// Switch the UI pipeline only now, a pipelined frame may still be in flight until here
+		if (pipelinedUi != uiPipeline.isThreaded())
+			uiPipeline.setThreaded(pipelinedUi);
+
+		frameCount++;
+		if (options.headless && frameCount >= options.frames)
+			break;
+	}
+
+	// Headless report, to stdout whatever the log level. The log goes first so the two don't mix.
+	if (options.headless)
+	{
+		double runTime = glfwGetTime() - runStart;
+		logFlush();
 
-		glfwSwapBuffers(window);
-		glfwPollEvents();
+		printf("Renderer: %s\n", (const char*)glGetString(GL_RENDERER));
+		printf("Triangles: %d, color animation: %s, drift: %s\n", triangleCount,
+			enableTriangleColorAnim ? colorAnimationModeNames[colorAnimationMode] : "off", enableDrift ? "on" : "off");
+		printf("UI: %s, job threads: %d\n", uiPipeline.isThreaded() ? "pipelined" : "serial", jobs.getThreadCount());
+		ImGui_ImplOpenGL3_RenderStats uiRenderStats = ImGui_ImplOpenGL3_GetRenderStats();
+		printf("UI rendering: %d draw calls, %d texture binds, %d scissor changes, %zu bytes uploaded\n", uiRenderStats.DrawCalls,
+			uiRenderStats.TextureBinds, uiRenderStats.ScissorChanges, uiRenderStats.BytesUploaded);
+		if (cullMode != CULL_OFF)
+			printf("Culling: %s, drawn: %zu, culled: %zu\n", cullModeNames[cullMode], drawnCount, culledCount);
+		const PickStats& pickStats = pickGrid.getStats();
+		printf("Picking: %zu grid cells, hovered: %lld, selected: %lld\n", pickStats.cells, hoveredTriangle,
+			selectedTriangle);
+		const BatchStats& batchStats = batcher.getStats();
+		printf("Batching: %s, %u draws in %u calls\n", batchStats.multiDraw ? "multi draw indirect" : "one call per draw",
+			batchStats.draws, batchStats.calls);
+		printf("Frames: %d in %.3f s, %.1f frames/sec\n", frameCount, runTime, frameCount / runTime);
+		if (mesh.ID != 0)
+		{
+			const MeshLoadStats& meshStats = mesh.getStats();
+			printf("Mesh: %llu triangles, %.1f of %.1f MB in %d frames, %.1f MB/s upload, %.1f MB/s overall, peak RSS %.1f MB\n",
+				meshStats.triangleCount, meshStats.bytesUploaded / (1024.0 * 1024.0), meshStats.bytesTotal / (1024.0 * 1024.0),
+				meshStats.frames, meshUploadRate(meshStats), meshOverallRate(meshStats), meshStats.peakResident / (1024.0 * 1024.0));
+		}
+		printf("%-12s %10s %10s\n", "Phase", "CPU ms", "GPU ms");
+		for (int phase = 0; phase < PHASE_COUNT; phase++)
+		{
+			printf("%-12s %10.4f %10.4f\n", Profiler::getPhaseName((ProfilerPhase)phase),
+				profiler.getCpuAverage((ProfilerPhase)phase), profiler.getGpuAverage((ProfilerPhase)phase));
+		}
+
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, headlessFBO);
+		printf("Final frame hash: %016llx\n", hashFramebuffer(SCREEN_WIDTH, SCREEN_HEIGHT));
+		fflush(stdout);
 	}
 
 end:
-	printf("Exiting TriColor");
+	LOG_INFO("Exiting TriColor");
+
+	uiPipeline.setThreaded(false);
+	instanceStream.release();
+	culler.release();
+	mesh.release();
+	batcher.release();
+	shaders.release();
+	profiler.release();
+	if (options.headless)
+	{
+		glDeleteFramebuffers(1, &headlessFBO);
+		glDeleteRenderbuffers(1, &headlessRBO);
+	}
 
 	ImGui_ImplOpenGL3_Shutdown();
 	ImGui_ImplGlfw_Shutdown();
 	ImGui::DestroyContext();
+	// Shared atlas, the context doesn't own it
+	IM_DELETE(fontAtlas);
 
+	shaderCompiler.stop();
 	glfwDestroyWindow(window);
 	glfwTerminate();
+	logStop();
 
 	return 0;
 }
\ No newline at end of file
@@ -0,0 +1,154 @@
+#include "mappedfile.h"
+
+#include <algorithm>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile()
+{
+#ifdef _WIN32
+	file = INVALID_HANDLE_VALUE;
+	mapping = NULL;
+#else
+	file = -1;
+#endif
+	view = NULL;
+	length = 0;
+	opened = false;
+}
+
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+#ifdef _WIN32
+bool MappedFile::open(const string& path)
+{
+	close();
+
+	// Share everything, editors replace shader files while we have them open
+	file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+		NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize))
+	{
+		close();
+		return false;
+	}
+
+	length = (size_t)fileSize.QuadPart;
+	opened = true;
+
+	// Empty files can't be mapped, they just have no data
+	if (length == 0)
+		return true;
+
+	mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (mapping != NULL)
+		view = (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+
+	if (view == NULL)
+	{
+		close();
+		return false;
+	}
+
+	return true;
+}
+
+void MappedFile::release(size_t offset, size_t size)
+{
+	if (view == NULL || offset >= length)
+		return;
+
+	// Unlocking pages that aren't locked takes them out of the working set
+	VirtualUnlock((LPVOID)(view + offset), std::min(size, length - offset));
+}
+
+void MappedFile::close()
+{
+	if (view != NULL)
+		UnmapViewOfFile(view);
+	if (mapping != NULL)
+		CloseHandle(mapping);
+	if (file != INVALID_HANDLE_VALUE)
+		CloseHandle(file);
+
+	file = INVALID_HANDLE_VALUE;
+	mapping = NULL;
+	view = NULL;
+	length = 0;
+	opened = false;
+}
+#else
+bool MappedFile::open(const string& path)
+{
+	close();
+
+	file = ::open(path.c_str(), O_RDONLY);
+	if (file < 0)
+		return false;
+
+	struct stat info;
+	if (fstat(file, &info) != 0)
+	{
+		close();
+		return false;
+	}
+
+	length = (size_t)info.st_size;
+	opened = true;
+
+	// Empty files can't be mapped, they just have no data
+	if (length == 0)
+		return true;
+
+	void* address = mmap(NULL, length, PROT_READ, MAP_PRIVATE, file, 0);
+	if (address == MAP_FAILED)
+	{
+		close();
+		return false;
+	}
+
+	view = (const char*)address;
+	return true;
+}
+
+void MappedFile::release(size_t offset, size_t size)
+{
+	if (view == NULL || offset >= length)
+		return;
+
+	// madvise wants a page aligned start
+	size_t page = (size_t)sysconf(_SC_PAGESIZE);
+	size_t start = offset - offset % page;
+	size_t end = std::min(offset + size, length);
+	madvise((void*)(view + start), end - start, MADV_DONTNEED);
+}
+
+void MappedFile::close()
+{
+	if (view != NULL)
+		munmap((void*)view, length);
+	if (file >= 0)
+		::close(file);
+
+	file = -1;
+	view = NULL;
+	length = 0;
+	opened = false;
+}
+#endif
@@ -0,0 +1,48 @@
+#pragma once
+
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+#include <cstddef>
+#include <string>
+
+typedef std::string string;
+
+/*
+A file mapped read-only into memory. The pages are shared with the OS file cache and only
+read in as they're touched, so opening costs no copy and no allocation.
+*/
+class MappedFile
+{
+public:
+	MappedFile();
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	// Map "path", replacing what was mapped before. False if it can't be opened.
+	bool open(const string& path);
+	void close();
+
+	// Let the OS drop the pages of a range that won't be read again, they're read back in
+	// from the file if they are. Only a hint, keeps the resident set down on big files.
+	void release(size_t offset, size_t size);
+
+	bool isOpen() const { return opened; }
+	// Contents, NULL for an empty file
+	const char* data() const { return view; }
+	size_t size() const { return length; }
+
+private:
+#ifdef _WIN32
+	void* file;
+	void* mapping;
+#else
+	int file;
+#endif
+	const char* view;
+	size_t length;
+	bool opened;
+};
+
+#endif // !MAPPEDFILE_H
@@ -0,0 +1,234 @@
+#include "mesh.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+static double nowMs()
+{
+	return std::chrono::duration<double, std::milli>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+size_t getPeakResidentBytes()
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+		return 0;
+	return counters.PeakWorkingSetSize;
+#else
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0)
+		return 0;
+#ifdef __APPLE__
+	return (size_t)usage.ru_maxrss;
+#else
+	// Kilobytes on Linux
+	return (size_t)usage.ru_maxrss * 1024;
+#endif
+#endif
+}
+
+Mesh::Mesh()
+{
+	ID = 0;
+	batcher = NULL;
+	stats = {};
+	loadStart = 0.0;
+}
+
+Mesh::~Mesh()
+{
+	release();
+}
+
+bool Mesh::load(const string& path, DrawBatcher& batcher, string& error)
+{
+	release();
+
+	if (!file.open(path))
+	{
+		error = "Failed to open mesh file " + path + ".";
+		return false;
+	}
+
+	MeshFileHeader header;
+	if (file.size() < sizeof(header))
+	{
+		file.close();
+		error = "Mesh file " + path + " is too short.";
+		return false;
+	}
+
+	memcpy(&header, file.data(), sizeof(header));
+	if (memcmp(header.magic, "TCMS", 4) != 0 || header.version != MESH_FILE_VERSION)
+	{
+		file.close();
+		error = "Mesh file " + path + " has an unknown format.";
+		return false;
+	}
+
+	// The vertices have to be all there, and whole triangles
+	size_t available = (file.size() - sizeof(header)) / sizeof(MeshVertex);
+	if (header.vertexCount % 3 != 0 || header.vertexCount > available)
+	{
+		file.close();
+		error = "Mesh file " + path + " is truncated.";
+		return false;
+	}
+
+	// The batcher's indices are 32 bit
+	if (header.vertexCount > 0xFFFFFFFFull)
+	{
+		file.close();
+		error = "Mesh file " + path + " has too many vertices.";
+		return false;
+	}
+
+	this->path = path;
+	stats.triangleCount = header.vertexCount / 3;
+	stats.bytesTotal = (size_t)header.vertexCount * sizeof(MeshVertex);
+	loadStart = nowMs();
+
+	// Room only, the data follows chunk by chunk
+	this->batcher = &batcher;
+	ID = batcher.addMesh(header.vertexCount, header.vertexCount);
+
+	if (stats.bytesTotal == 0)
+		file.close();
+
+	return true;
+}
+
+bool Mesh::update()
+{
+	if (!file.isOpen())
+		return false;
+
+	double start = nowMs();
+	const char* vertices = file.data() + sizeof(MeshFileHeader);
+
+	// At least one chunk per frame, more while the budget lasts
+	do
+	{
+		size_t size = std::min((size_t)MESH_UPLOAD_CHUNK / sizeof(MeshVertex) * sizeof(MeshVertex),
+			stats.bytesTotal - stats.bytesUploaded);
+		size_t first = stats.bytesUploaded / sizeof(MeshVertex);
+		size_t count = size / sizeof(MeshVertex);
+		batcher->uploadVertices(ID, first, (const MeshVertex*)(vertices + stats.bytesUploaded), count);
+
+		indices.resize(count);
+		for (size_t i = 0; i < count; i++)
+			indices[i] = (unsigned int)(first + i);
+		batcher->uploadIndices(ID, first, indices.data(), count);
+
+		// GL has its own copy now
+		file.release(sizeof(MeshFileHeader) + stats.bytesUploaded, size);
+		stats.bytesUploaded += size;
+	} while (stats.bytesUploaded < stats.bytesTotal && nowMs() - start < MESH_UPLOAD_BUDGET_MS);
+
+	double end = nowMs();
+	stats.uploadMs += end - start;
+	stats.elapsedMs = end - loadStart;
+	stats.frames++;
+	stats.peakResident = getPeakResidentBytes();
+
+	if (stats.bytesUploaded < stats.bytesTotal)
+		return false;
+
+	file.close();
+	indices = std::vector<unsigned int>();
+	return true;
+}
+
+void Mesh::draw(Shader& material, const float* position) const
+{
+	if (ID == 0 || stats.bytesUploaded == 0)
+		return;
+
+	// Only whole triangles that have arrived
+	BatchDraw draw = {};
+	draw.position[0] = position[0];
+	draw.position[1] = position[1];
+	draw.scale = 1.0f;
+	draw.indexCount = (unsigned int)(stats.bytesUploaded / (sizeof(MeshVertex) * 3) * 3);
+	if (draw.indexCount > 0)
+		batcher->add(material, ID, draw);
+}
+
+void Mesh::release()
+{
+	file.close();
+	indices = std::vector<unsigned int>();
+
+	ID = 0;
+	batcher = NULL;
+	stats = {};
+	path.clear();
+}
+
+float Mesh::getProgress() const
+{
+	if (stats.bytesTotal == 0)
+		return ID != 0 ? 1.0f : 0.0f;
+
+	return (float)((double)stats.bytesUploaded / stats.bytesTotal);
+}
+
+bool writeTestMesh(const string& path, unsigned long long triangleCount)
+{
+	std::ofstream file(path.c_str(), std::ios::binary | std::ios::trunc);
+	if (!file.is_open())
+		return false;
+
+	MeshFileHeader header = { { 'T', 'C', 'M', 'S' }, MESH_FILE_VERSION, triangleCount * 3 };
+	file.write((const char*)&header, sizeof(header));
+
+	// A square grid of cells in [-1, 1], one triangle per cell, red/green across and blue down
+	unsigned long long side = 1;
+	while (side * side < triangleCount)
+		side++;
+	float cell = 2.0f / side;
+
+	std::vector<MeshVertex> block;
+	block.reserve(3 * 65536);
+
+	for (unsigned long long i = 0; i < triangleCount; i++)
+	{
+		float column = (float)(i % side);
+		float row = (float)(i / side);
+		float x = -1.0f + column * cell;
+		float y = -1.0f + row * cell;
+
+		float u = column / side;
+		float v = row / side;
+
+		MeshVertex corners[3] = {
+			{ { x, y, 0.0f }, { u, 1.0f - u, v } },
+			{ { x + cell * 0.9f, y, 0.0f }, { u, 1.0f - u, v } },
+			{ { x, y + cell * 0.9f, 0.0f }, { u, 1.0f - u, v } }
+		};
+		block.insert(block.end(), corners, corners + 3);
+
+		if (block.size() >= block.capacity())
+		{
+			file.write((const char*)block.data(), block.size() * sizeof(MeshVertex));
+			block.clear();
+		}
+	}
+
+	file.write((const char*)block.data(), block.size() * sizeof(MeshVertex));
+	return file.good();
+}
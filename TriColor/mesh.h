@@ -0,0 +1,98 @@
+#pragma once
+
+#ifndef MESH_H
+#define MESH_H
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "batcher.h"
+#include "mappedfile.h"
+
+typedef std::string string;
+
+#define MESH_FILE_VERSION 1
+// Bytes per glBufferSubData call, and how long uploads may take per frame at most
+#define MESH_UPLOAD_CHUNK (4 * 1024 * 1024)
+#define MESH_UPLOAD_BUDGET_MS 4.0
+
+/*
+Mesh file (.tcm): a header followed by "vertexCount" MeshVertex records, three per triangle.
+Little endian, no padding.
+*/
+struct MeshFileHeader
+{
+	char magic[4];	// "TCMS"
+	unsigned int version;
+	unsigned long long vertexCount;
+};
+
+struct MeshLoadStats
+{
+	unsigned long long triangleCount;
+	size_t bytesTotal;
+	size_t bytesUploaded;
+	// Frames the upload was spread over
+	int frames;
+	// Time spent in glBufferSubData, and from load() to the last chunk
+	double uploadMs;
+	double elapsedMs;
+	// Largest resident set of the process so far, in bytes
+	size_t peakResident;
+};
+
+/*
+A triangle mesh streamed from a memory mapped file into a DrawBatcher's arenas.
+
+load() only maps and checks the file and makes room in the arenas. update() then uploads it in
+MESH_UPLOAD_CHUNK pieces for at most MESH_UPLOAD_BUDGET_MS per frame, so a huge mesh loads
+over many frames while the UI keeps running. Pages already uploaded are handed back to the
+OS, the resident set doesn't grow with the file. draw() draws what has arrived so far.
+
+The file has no indices, each chunk's are counted up as it goes.
+*/
+class Mesh
+{
+public:
+	// Mesh handle in the batcher, 0 without one
+	unsigned int ID;
+
+	Mesh();
+	~Mesh();
+
+	Mesh(const Mesh&) = delete;
+	Mesh& operator=(const Mesh&) = delete;
+
+	// Start loading "path" into "batcher". False if it's not a valid mesh file, "error" tells why.
+	bool load(const string& path, DrawBatcher& batcher, string& error);
+	// Upload the next chunks, once per frame. Returns true when the last chunk went up.
+	bool update();
+	// Queue a draw of the mesh with "material" at "position", at its own size
+	void draw(Shader& material, const float* position) const;
+	// Forget the mesh, its room in the arenas is only freed with the batcher
+	void release();
+
+	bool isLoading() const { return file.isOpen(); }
+	bool isLoaded() const { return ID != 0 && !file.isOpen(); }
+	float getProgress() const;
+	const MeshLoadStats& getStats() const { return stats; }
+	const string& getPath() const { return path; }
+
+private:
+	MappedFile file;
+	string path;
+	DrawBatcher* batcher;
+	std::vector<unsigned int> indices;
+	MeshLoadStats stats;
+	double loadStart;
+};
+
+// Write a test mesh of "triangleCount" small triangles filling the screen in a color gradient
+bool writeTestMesh(const string& path, unsigned long long triangleCount);
+
+// Largest resident set of the process so far, in bytes, 0 if unknown
+size_t getPeakResidentBytes();
+
+#endif // !MESH_H
@@ -0,0 +1,373 @@
+#include "pickgrid.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+
+// Random points checked against testing every triangle, and timed
+#define PICK_CHECK_POINTS 1000
+#define PICK_TIME_POINTS 65536
+// Entities in the benchmark, and simulation steps it drifts them for
+#define PICK_BENCH_COUNT 1000000
+#define PICK_BENCH_STEPS 600
+// Longest a pick may take on average
+#define PICK_BUDGET_NS 1000.0
+
+typedef std::chrono::high_resolution_clock Clock;
+
+static inline float blend(float from, float to, float alpha)
+{
+	return from + (to - from) * alpha;
+}
+
+/*
+Whether the triangle around (centerX, centerY) contains the point. "extent" is half its scale:
+the head is at centerY + extent, the feet at centerX -+ extent, centerY - extent.
+*/
+static inline bool hitsTriangle(float x, float y, float centerX, float centerY, float extent)
+{
+	float height = y - (centerY - extent);
+	if (height < 0.0f || height > 2.0f * extent)
+		return false;
+
+	return fabsf(x - centerX) <= extent - 0.5f * height;
+}
+
+// Where a coordinate falls on a grid of 2^bits cells over the scene area, in cells
+static inline float gridCoordinate(float v, int bits)
+{
+	return (v + SCENE_BORDER) * ((float)(1 << bits) / (2.0f * SCENE_BORDER));
+}
+
+/*
+Cell a center is sorted into, row after row. Centers outside the scene area, only ever by
+rounding, go to the border cells.
+*/
+static inline unsigned int cellIndex(float x, float y, int bits)
+{
+	float maxCell = (float)((1 << bits) - 1);
+	float cellX = std::min(std::max(gridCoordinate(x, bits), 0.0f), maxCell);
+	float cellY = std::min(std::max(gridCoordinate(y, bits), 0.0f), maxCell);
+
+	return ((unsigned int)cellY << bits) | (unsigned int)cellX;
+}
+
+/*
+Cells along one axis a center in [low, high] can be sorted into, false if there are none.
+cellIndex() rounds the same way, so it never puts such a center outside them.
+*/
+static inline bool cellRange(float low, float high, int bits, int& first, int& last)
+{
+	float lowCell = gridCoordinate(low, bits);
+	float highCell = gridCoordinate(high, bits);
+	float maxCell = (float)((1 << bits) - 1);
+	if (highCell < 0.0f || lowCell >= maxCell + 1.0f)
+		return false;
+
+	first = (int)std::max(lowCell, 0.0f);
+	last = (int)std::min(highCell, maxCell);
+	return true;
+}
+
+PickGrid::PickGrid(JobSystem& jobs) : jobs(jobs)
+{
+	stats = {};
+}
+
+PickGrid::~PickGrid()
+{
+}
+
+void PickGrid::build(size_t count)
+{
+	Clock::time_point start = Clock::now();
+
+	size_t bandCount = std::max((count + PICK_BAND_SIZE - 1) / PICK_BAND_SIZE, (size_t)1);
+	size_t cellCount = 0;
+
+	bands.clear();
+	for (size_t b = 0; b < bandCount; b++)
+	{
+		// The smallest grid with at most PICK_CELL_SIZE entities per cell on average
+		PickBand band;
+		band.first = (unsigned int)(count * b / bandCount);
+		band.count = (unsigned int)(count * (b + 1) / bandCount) - band.first;
+		band.cellBits = 0;
+		while (((size_t)1 << (2 * band.cellBits)) * PICK_CELL_SIZE < band.count)
+			band.cellBits++;
+		band.firstCell = (unsigned int)cellCount;
+		band.drift = 0.0f;
+
+		bands.push_back(band);
+		cellCount += (size_t)1 << (2 * band.cellBits);
+	}
+
+	// Bounds, entities and items are all left to update()
+	cells.resize(cellCount);
+	cellOffsets.resize(cellCount);
+	items.resize(count);
+
+	stats.cells = cellCount;
+	stats.buildMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+void PickGrid::update(const Scene& scene)
+{
+	if (scene.size() != items.size())
+		build(scene.size());
+
+	Clock::time_point start = Clock::now();
+
+	jobs.parallelFor(0, bands.size(), 1, [this, &scene](size_t begin, size_t end)
+	{
+		for (size_t b = begin; b < end; b++)
+			updateBand(bands[b], scene);
+	});
+
+	stats.updateMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+long long PickGrid::pick(float x, float y, float scale, float alpha) const
+{
+	if (items.empty())
+		return -1;
+
+	float extent = 0.5f * scale;
+	// A little more for the bounds, a blend can round past both of its ends
+	float margin = extent + 1e-6f;
+
+	long long best = -1;
+	for (size_t b = bands.size(); b-- > 0;)
+	{
+		const PickBand& band = bands[b];
+
+		// A center reaching the point is within the margin of it, plus how far it moved
+		float reach = margin + band.drift;
+		int firstX, lastX, firstY, lastY;
+		if (!cellRange(x - reach, x + reach, band.cellBits, firstX, lastX)
+			|| !cellRange(y - reach, y + reach, band.cellBits, firstY, lastY))
+			continue;
+
+		const PickCell* bandCells = cells.data() + band.firstCell;
+		for (int cellY = firstY; cellY <= lastY; cellY++)
+		{
+			for (int cellX = firstX; cellX <= lastX; cellX++)
+			{
+				// Empty cells have inverted bounds and are never near
+				const PickCell& cell = bandCells[(cellY << band.cellBits) + cellX];
+				if ((long long)cell.maxIndex <= best
+					|| x < cell.min[0] - margin || x > cell.max[0] + margin || y < cell.min[1] - margin || y > cell.max[1] + margin)
+					continue;
+
+				// Items are in index order, the last one hit is the cell's topmost
+				for (unsigned int k = cell.offset + cell.count; k-- > cell.offset;)
+				{
+					const PickItem& item = items[k];
+					if ((long long)item.entity <= best)
+						break;
+					if (hitsTriangle(x, y, blend(item.previousX, item.x, alpha), blend(item.previousY, item.y, alpha), extent))
+					{
+						best = item.entity;
+						break;
+					}
+				}
+			}
+		}
+
+		// Every band below is drawn under this one
+		if (best >= 0)
+			return best;
+	}
+
+	return -1;
+}
+
+/*
+Counting sort of the band's entities into its part of "items", by cell. Within a cell they
+stay in index order. The cells are bounded while counting.
+*/
+void PickGrid::updateBand(PickBand& band, const Scene& scene)
+{
+	const float* x = scene.getX();
+	const float* y = scene.getY();
+	const float* previousX = scene.getPreviousX();
+	const float* previousY = scene.getPreviousY();
+	size_t cellCount = (size_t)1 << (2 * band.cellBits);
+	size_t end = band.first + band.count;
+	PickCell* bandCells = cells.data() + band.firstCell;
+
+	// Empty cells keep inverted bounds, nothing ever reaches them
+	for (size_t c = 0; c < cellCount; c++)
+	{
+		PickCell& cell = bandCells[c];
+		cell.min[0] = cell.min[1] = FLT_MAX;
+		cell.max[0] = cell.max[1] = -FLT_MAX;
+		cell.count = 0;
+		cell.maxIndex = 0;
+	}
+
+	float drift = 0.0f;
+	for (size_t i = band.first; i < end; i++)
+	{
+		PickCell& cell = bandCells[cellIndex(x[i], y[i], band.cellBits)];
+		cell.min[0] = std::min(cell.min[0], std::min(x[i], previousX[i]));
+		cell.min[1] = std::min(cell.min[1], std::min(y[i], previousY[i]));
+		cell.max[0] = std::max(cell.max[0], std::max(x[i], previousX[i]));
+		cell.max[1] = std::max(cell.max[1], std::max(y[i], previousY[i]));
+		cell.count++;
+		cell.maxIndex = (unsigned int)i;
+		drift = std::max(drift, std::max(fabsf(x[i] - previousX[i]), fabsf(y[i] - previousY[i])));
+	}
+	band.drift = drift;
+
+	unsigned int* offsets = cellOffsets.data() + band.firstCell;
+	unsigned int offset = band.first;
+	for (size_t c = 0; c < cellCount; c++)
+	{
+		bandCells[c].offset = offset;
+		offsets[c] = offset;
+		offset += bandCells[c].count;
+	}
+
+	for (size_t i = band.first; i < end; i++)
+	{
+		PickItem& item = items[offsets[cellIndex(x[i], y[i], band.cellBits)]++];
+		item.x = x[i];
+		item.y = y[i];
+		item.previousX = previousX[i];
+		item.previousY = previousY[i];
+		item.entity = (unsigned int)i;
+	}
+}
+
+static inline unsigned int xorshift32(unsigned int& state)
+{
+	state ^= state << 13;
+	state ^= state >> 17;
+	state ^= state << 5;
+	return state;
+}
+
+// Around the scene, the border is at 0.5, some points miss everything
+static float randomCoordinate(unsigned int& seed)
+{
+	return ((float)(xorshift32(seed) & 0xFFFFFF) / (float)0xFFFFFF - 0.5f) * 1.2f;
+}
+
+// Reference pick, the last entity hit is drawn on top
+static long long pickEveryTriangle(const Scene& scene, float x, float y, float scale, float alpha)
+{
+	for (size_t i = scene.size(); i-- > 0;)
+	{
+		float centerX = blend(scene.getPreviousX()[i], scene.getX()[i], alpha);
+		float centerY = blend(scene.getPreviousY()[i], scene.getY()[i], alpha);
+		if (hitsTriangle(x, y, centerX, centerY, 0.5f * scale))
+			return (long long)i;
+	}
+
+	return -1;
+}
+
+static bool checkPicks(const PickGrid& grid, const Scene& scene, float scale, float alpha, unsigned int seed)
+{
+	int hits = 0, mismatches = 0;
+	for (int i = 0; i < PICK_CHECK_POINTS; i++)
+	{
+		float x = randomCoordinate(seed);
+		float y = randomCoordinate(seed);
+		long long expected = pickEveryTriangle(scene, x, y, scale, alpha);
+		long long picked = grid.pick(x, y, scale, alpha);
+
+		if (expected >= 0)
+			hits++;
+		if (picked != expected)
+		{
+			if (mismatches < 5)
+				printf("  Mismatch at %.6f, %.6f: picked %lld, expected %lld\n", x, y, picked, expected);
+			mismatches++;
+		}
+	}
+
+	printf("  %d points, %d on a triangle, %d mismatches\n", PICK_CHECK_POINTS, hits, mismatches);
+	return mismatches == 0;
+}
+
+static volatile long long pickSink;
+
+// Nanoseconds per pick, over a fixed set of points for at least 0.1 s
+static double timePicks(const PickGrid& grid, float scale, float alpha)
+{
+	std::vector<float> points(2 * PICK_TIME_POINTS);
+	unsigned int seed = 0x27D4EB2Fu;
+	for (float& coordinate : points)
+		coordinate = randomCoordinate(seed);
+
+	long long found = 0;
+	size_t picks = 0;
+	Clock::time_point start = Clock::now();
+	double elapsed = 0.0;
+	do
+	{
+		for (size_t i = 0; i < PICK_TIME_POINTS; i++)
+			found += grid.pick(points[2 * i], points[2 * i + 1], scale, alpha);
+
+		picks += PICK_TIME_POINTS;
+		elapsed = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	} while (elapsed < 100.0);
+
+	// Keeps the picks from being optimized out
+	pickSink = found;
+
+	return elapsed * 1e6 / picks;
+}
+
+bool benchmarkPick(int threads)
+{
+	JobSystem jobs(threads > 0 ? threads - 1 : -1);
+
+	// The scale the app draws this many triangles at
+	size_t count = PICK_BENCH_COUNT;
+	float scale = fmaxf(1.0f / sqrtf((float)count), 0.01f);
+
+	Scene scene;
+	scene.resize(count);
+	PickGrid grid(jobs);
+	grid.update(scene);
+
+	const PickStats& stats = grid.getStats();
+	printf("Picking, %zu entities, %d threads\n", count, jobs.getThreadCount());
+	printf("Build: %.1f ms, %zu cells, update: %.2f ms\n", stats.buildMs, stats.cells, stats.updateMs);
+
+	bool passed = checkPicks(grid, scene, scale, 1.0f, 0x1B873593u);
+	double ns = timePicks(grid, scale, 1.0f);
+	bool fast = ns < PICK_BUDGET_NS;
+	printf("Pick: %.0f ns per query, %s\n", ns, ns < PICK_BUDGET_NS ? "under 1 us" : "over the 1 us budget");
+
+	// Drift at 60 Hz, updating after every step like the app does while the cursor is on the scene
+	printf("Drifting %d steps\n", PICK_BENCH_STEPS);
+	printf("%-8s %10s %10s\n", "Step", "Update ms", "Pick ns");
+	double updateMs = 0.0;
+	for (int step = 1; step <= PICK_BENCH_STEPS; step++)
+	{
+		scene.step(1.0f / 60.0f, jobs);
+		grid.update(scene);
+		updateMs += stats.updateMs;
+
+		if (step % (PICK_BENCH_STEPS / 5) == 0)
+		{
+			ns = timePicks(grid, scale, 0.5f);
+			fast = fast && ns < PICK_BUDGET_NS;
+			printf("%-8d %10.2f %10.0f\n", step, updateMs / (PICK_BENCH_STEPS / 5), ns);
+			updateMs = 0.0;
+		}
+	}
+
+	printf("After drifting:\n");
+	passed = checkPicks(grid, scene, scale, 0.5f, 0x5BD1E995u) && passed;
+
+	printf(passed ? "All picks matched\n" : "Picks FAILED\n");
+	printf(fast ? "Every pick timing under 1 us\n" : "Picks over the 1 us budget, FAILED\n");
+	return passed && fast;
+}
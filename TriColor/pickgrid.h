@@ -0,0 +1,129 @@
+#pragma once
+
+#ifndef PICKGRID_H
+#define PICKGRID_H
+#include <cstddef>
+#include <vector>
+
+#include "jobs.h"
+#include "scene.h"
+
+// Triangles per cell a band's grid is sized for, on average
+#define PICK_CELL_SIZE 4
+// Entities of a band at most, the scene splits into bands of consecutive indices above it
+#define PICK_BAND_SIZE 65536
+
+/*
+A grid cell of a band, bounding the triangles sorted into it. They're "count" items from
+"offset" on. 32 bytes, two cells per cache line.
+*/
+struct PickCell
+{
+	float min[2];
+	float max[2];
+	unsigned int offset;
+	unsigned int count;
+	// Highest entity in the cell, later entities are drawn on top
+	unsigned int maxIndex;
+	unsigned int padding;
+};
+
+struct PickStats
+{
+	size_t cells;
+	double buildMs;
+	// Last update(), sorting the entities into the grids and bounding the cells
+	double updateMs;
+};
+
+/*
+Uniform grids over the triangle instances of a Scene, for picking them under the cursor. Every
+cell bounds its entity centers at the previous and the current step, and a query grows the
+point by half the triangle scale instead. So the bounds don't depend on the scale and pick()
+holds for any blend between the two steps.
+
+Large scenes have many triangles over every point and the topmost, the last drawn, wins. So
+the entities split into bands of consecutive indices, each band a uniform grid over the scene
+area. A query searches the last band first and skips every band below once it hit, most never
+leave the first one.
+
+Within a band a query looks up the cells around the point directly and tests their bounds. At
+10^6 entities a triangle drifts further in a step than a cell spans, so fixed bounds would
+loosen within a few steps. update() sorts every band's entities into its cells again instead,
+a counting sort that bounds the cells on the way, and a band records how far its triangles
+moved past their cells. The bands are independent jobs on the JobSystem. It's the bulk of the
+cost, so the app only updates when it's about to pick.
+
+The positions are copied into the items while sorting, so a query touches only the cells and
+the items near the point.
+*/
+class PickGrid
+{
+public:
+	PickGrid(JobSystem& jobs);
+	~PickGrid();
+
+	PickGrid(const PickGrid&) = delete;
+	PickGrid& operator=(const PickGrid&) = delete;
+
+	/*
+	Sort the entities into the cells, laying the grids out again first if the scene was
+	resized. Only needed before picking, after the scene stepped or was resized.
+	*/
+	void update(const Scene& scene);
+
+	/*
+	Topmost triangle containing the point, in scene coordinates (the scene position taken off),
+	with the triangles drawn at "scale" and blended by "alpha" between the last two steps.
+	-1 if there is none.
+	*/
+	long long pick(float x, float y, float scale, float alpha) const;
+
+	const PickStats& getStats() const { return stats; }
+
+private:
+	// An entity and its position, in its band's cell order
+	struct PickItem
+	{
+		float x, y;
+		float previousX, previousY;
+		unsigned int entity;
+	};
+
+	// Entities [first, first + count) in a grid of 2^cellBits cells per axis, row after row
+	// from "firstCell" on
+	struct PickBand
+	{
+		unsigned int first;
+		unsigned int count;
+		int cellBits;
+		unsigned int firstCell;
+		// Furthest a center moved in the last step, the cells' bounds reach this far past them
+		float drift;
+	};
+
+	JobSystem& jobs;
+	std::vector<PickBand> bands;
+	std::vector<PickCell> cells;
+	std::vector<PickItem> items;
+
+	// Where the next item of every cell goes while sorting. One per cell, kept to not allocate
+	// every update.
+	std::vector<unsigned int> cellOffsets;
+
+	PickStats stats;
+
+	// Bands and cells for "count" entities, left empty until sorted
+	void build(size_t count);
+	// Sort a band's entities into its cells and bound them
+	void updateBand(PickBand& band, const Scene& scene);
+};
+
+/*
+Check pick() against testing every triangle and time it at 10^6 entities, then again after
+the entities drifted for a while, on "threads" (0 for every core). Returns whether every
+pick matched.
+*/
+bool benchmarkPick(int threads);
+
+#endif // !PICKGRID_H
@@ -0,0 +1,301 @@
+#include "profiler.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#include "imgui.h"
+
+static const char* phaseNames[PHASE_COUNT] = {
+	"Input",
+	"Simulation",
+	"UI build",
+	"Scene draw",
+	"UI render",
+	"Swap"
+};
+
+// Column names in the CSV export
+static const char* phaseKeys[PHASE_COUNT] = {
+	"input",
+	"simulation",
+	"ui_build",
+	"scene",
+	"ui_render",
+	"swap"
+};
+
+Profiler::Profiler()
+{
+	memset(cpuHistory, 0, sizeof(cpuHistory));
+	memset(gpuHistory, 0, sizeof(gpuHistory));
+	memset(frameHistory, 0, sizeof(frameHistory));
+	memset(gpuLatest, 0, sizeof(gpuLatest));
+	memset(cpuCurrent, 0, sizeof(cpuCurrent));
+	memset(queries, 0, sizeof(queries));
+	memset(queryIssued, 0, sizeof(queryIssued));
+	memset(queryFrame, 0, sizeof(queryFrame));
+
+	head = 0;
+	frames = 0;
+	querySlot = 0;
+	hasQueries = false;
+	hasGpuTimings = false;
+	exportStatus[0] = '\0';
+	frameStart = Clock::now();
+}
+
+Profiler::~Profiler()
+{
+	release();
+}
+
+void Profiler::init()
+{
+	if (hasQueries)
+		return;
+
+	glGenQueries(PHASE_COUNT * PROFILER_QUERY_FRAMES, &queries[0][0]);
+	hasQueries = true;
+	hasGpuTimings = true;
+}
+
+void Profiler::release()
+{
+	if (!hasQueries)
+		return;
+
+	glDeleteQueries(PHASE_COUNT * PROFILER_QUERY_FRAMES, &queries[0][0]);
+	memset(queryIssued, 0, sizeof(queryIssued));
+	hasQueries = false;
+}
+
+const char* Profiler::getPhaseName(ProfilerPhase phase)
+{
+	return phaseNames[phase];
+}
+
+void Profiler::beginFrame()
+{
+	frameStart = Clock::now();
+	memset(cpuCurrent, 0, sizeof(cpuCurrent));
+
+	if (!hasQueries)
+		return;
+
+	// Collect the oldest queries before their slot is reused this frame
+	querySlot = (querySlot + 1) % PROFILER_QUERY_FRAMES;
+
+	for (int phase = 0; phase < PHASE_COUNT; phase++)
+	{
+		if (!queryIssued[phase][querySlot])
+			continue;
+
+		GLuint available = GL_FALSE;
+		glGetQueryObjectuiv(queries[phase][querySlot], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (available)
+		{
+			GLuint64 elapsed = 0;
+			glGetQueryObjectui64v(queries[phase][querySlot], GL_QUERY_RESULT, &elapsed);
+
+			// llvmpipe reports a timestamp instead of a duration for the very first query
+			if (elapsed > PROFILER_MAX_GPU_NS)
+			{
+				queryIssued[phase][querySlot] = false;
+				continue;
+			}
+
+			gpuLatest[phase] = (float)(elapsed / 1000000.0);
+			gpuHistory[phase][queryFrame[querySlot]] = gpuLatest[phase];
+		}
+
+		queryIssued[phase][querySlot] = false;
+	}
+
+	queryFrame[querySlot] = head;
+}
+
+void Profiler::endFrame()
+{
+	for (int phase = 0; phase < PHASE_COUNT; phase++)
+		cpuHistory[phase][head] = (float)cpuCurrent[phase];
+
+	// GPU results for this frame arrive a few frames later, until then use the latest one
+	for (int phase = 0; phase < PHASE_COUNT; phase++)
+		gpuHistory[phase][head] = gpuLatest[phase];
+
+	frameHistory[head] = (float)std::chrono::duration<double, std::milli>(Clock::now() - frameStart).count();
+
+	head = (head + 1) % PROFILER_HISTORY;
+	if (frames < PROFILER_HISTORY)
+		frames++;
+}
+
+void Profiler::beginCpu(ProfilerPhase phase)
+{
+	cpuStart[phase] = Clock::now();
+}
+
+void Profiler::endCpu(ProfilerPhase phase)
+{
+	cpuCurrent[phase] += std::chrono::duration<double, std::milli>(Clock::now() - cpuStart[phase]).count();
+}
+
+void Profiler::beginGpu(ProfilerPhase phase)
+{
+	if (!hasQueries || queryIssued[phase][querySlot])
+		return;
+
+	glBeginQuery(GL_TIME_ELAPSED, queries[phase][querySlot]);
+}
+
+void Profiler::endGpu(ProfilerPhase phase)
+{
+	if (!hasQueries || queryIssued[phase][querySlot])
+		return;
+
+	glEndQuery(GL_TIME_ELAPSED);
+	queryIssued[phase][querySlot] = true;
+}
+
+static float averageOf(const float* values, int count)
+{
+	if (count == 0)
+		return 0.0f;
+
+	float sum = 0.0f;
+	for (int i = 0; i < count; i++)
+		sum += values[i];
+
+	return sum / count;
+}
+
+float Profiler::getCpuAverage(ProfilerPhase phase) const
+{
+	return averageOf(cpuHistory[phase], frames);
+}
+
+float Profiler::getGpuAverage(ProfilerPhase phase) const
+{
+	return averageOf(gpuHistory[phase], frames);
+}
+
+float Profiler::getFrameAverage() const
+{
+	return averageOf(frameHistory, frames);
+}
+
+void Profiler::copyHistory(const Profiler& other)
+{
+	memcpy(cpuHistory, other.cpuHistory, sizeof(cpuHistory));
+	memcpy(gpuHistory, other.gpuHistory, sizeof(gpuHistory));
+	memcpy(frameHistory, other.frameHistory, sizeof(frameHistory));
+	memcpy(gpuLatest, other.gpuLatest, sizeof(gpuLatest));
+	head = other.head;
+	frames = other.frames;
+	hasGpuTimings = other.hasGpuTimings;
+}
+
+bool Profiler::exportCsv(const char* path) const
+{
+	std::ofstream file(path);
+	if (!file.is_open())
+		return false;
+
+	file << "frame,frame_ms";
+	for (int phase = 0; phase < PHASE_COUNT; phase++)
+		file << ",cpu_" << phaseKeys[phase] << "_ms";
+	for (int phase = 0; phase < PHASE_COUNT; phase++)
+		file << ",gpu_" << phaseKeys[phase] << "_ms";
+	file << "\n";
+
+	// Oldest first
+	int first = (head + PROFILER_HISTORY - frames) % PROFILER_HISTORY;
+	for (int i = 0; i < frames; i++)
+	{
+		int index = (first + i) % PROFILER_HISTORY;
+
+		file << i << "," << frameHistory[index];
+		for (int phase = 0; phase < PHASE_COUNT; phase++)
+			file << "," << cpuHistory[phase][index];
+		for (int phase = 0; phase < PHASE_COUNT; phase++)
+			file << "," << gpuHistory[phase][index];
+		file << "\n";
+	}
+
+	return file.good();
+}
+
+void Profiler::showWindow(bool* open)
+{
+	if (!ImGui::Begin("Performance", open))
+	{
+		ImGui::End();
+		return;
+	}
+
+	ImGui::Text("Frame: %.3f ms (%.1f FPS)", getFrameAverage(), 1000.0f / (getFrameAverage() + 1e-6f));
+	if (!hasGpuTimings)
+		ImGui::TextDisabled("GPU timer queries are not available");
+
+	// Averages of every phase side by side
+	float cpuAverages[PHASE_COUNT], gpuAverages[PHASE_COUNT];
+	float highest = 0.0f;
+	for (int phase = 0; phase < PHASE_COUNT; phase++)
+	{
+		cpuAverages[phase] = getCpuAverage((ProfilerPhase)phase);
+		gpuAverages[phase] = getGpuAverage((ProfilerPhase)phase);
+		if (cpuAverages[phase] > highest)
+			highest = cpuAverages[phase];
+		if (gpuAverages[phase] > highest)
+			highest = gpuAverages[phase];
+	}
+
+	ImGui::PlotHistogram("CPU phases", cpuAverages, PHASE_COUNT, 0, NULL, 0.0f, highest, ImVec2(0, 60.0f));
+	ImGui::SetItemTooltip("Input, simulation, UI build, scene draw, UI render, swap");
+	ImGui::PlotHistogram("GPU phases", gpuAverages, PHASE_COUNT, 0, NULL, 0.0f, highest, ImVec2(0, 60.0f));
+	ImGui::SetItemTooltip("Input, simulation, UI build, scene draw, UI render, swap");
+
+	// Rolling history of each phase
+	if (ImGui::BeginTable("Phases", 3, ImGuiTableFlags_BordersInnerV | ImGuiTableFlags_SizingStretchProp))
+	{
+		ImGui::TableSetupColumn("Phase", ImGuiTableColumnFlags_WidthFixed);
+		ImGui::TableSetupColumn("CPU");
+		ImGui::TableSetupColumn("GPU");
+		ImGui::TableHeadersRow();
+
+		for (int phase = 0; phase < PHASE_COUNT; phase++)
+		{
+			char overlay[32];
+
+			ImGui::TableNextRow();
+			ImGui::TableNextColumn();
+			ImGui::TextUnformatted(phaseNames[phase]);
+
+			ImGui::PushID(phase);
+			ImGui::TableNextColumn();
+			snprintf(overlay, sizeof(overlay), "%.3f ms", cpuAverages[phase]);
+			ImGui::PlotLines("##cpu", cpuHistory[phase], PROFILER_HISTORY, head, overlay, 0.0f, FLT_MAX, ImVec2(-1.0f, 40.0f));
+
+			ImGui::TableNextColumn();
+			snprintf(overlay, sizeof(overlay), "%.3f ms", gpuAverages[phase]);
+			ImGui::PlotLines("##gpu", gpuHistory[phase], PROFILER_HISTORY, head, overlay, 0.0f, FLT_MAX, ImVec2(-1.0f, 40.0f));
+			ImGui::PopID();
+		}
+
+		ImGui::EndTable();
+	}
+
+	if (ImGui::Button("Export CSV"))
+	{
+		const char* path = "performance.csv";
+		if (exportCsv(path))
+			snprintf(exportStatus, sizeof(exportStatus), "Saved %d frames to %s", frames, path);
+		else
+			snprintf(exportStatus, sizeof(exportStatus), "Failed to write %s", path);
+	}
+	ImGui::SameLine();
+	ImGui::TextUnformatted(exportStatus);
+
+	ImGui::End();
+}
@@ -0,0 +1,123 @@
+#pragma once
+
+#ifndef PROFILER_H
+#define PROFILER_H
+#include <glad/glad.h>
+
+#include <chrono>
+
+// Frames of history kept for the graphs and the CSV export
+#define PROFILER_HISTORY 240
+// GPU queries in flight per phase, results are read this many frames later
+#define PROFILER_QUERY_FRAMES 4
+// GPU results above this are treated as driver glitches and dropped (10 seconds)
+#define PROFILER_MAX_GPU_NS 10000000000ull
+
+enum ProfilerPhase
+{
+	PHASE_INPUT,
+	PHASE_SIMULATION,
+	PHASE_UI_BUILD,
+	PHASE_SCENE,
+	PHASE_UI_RENDER,
+	PHASE_SWAP,
+	PHASE_COUNT
+};
+
+/*
+Per-phase CPU and GPU timings of the main loop.
+
+CPU phases can be opened and closed several times per frame, the time adds up. GPU phases
+use GL_TIME_ELAPSED queries, at most one per phase per frame and never nested. Their
+results are read back PROFILER_QUERY_FRAMES frames later, only once available, so the
+profiler never waits on the GPU.
+*/
+class Profiler
+{
+public:
+	Profiler();
+	~Profiler();
+
+	Profiler(const Profiler&) = delete;
+	Profiler& operator=(const Profiler&) = delete;
+
+	// Create the GL queries, needs a current context
+	void init();
+	// Delete the GL queries. Done by the destructor too, call it first if the context goes away earlier.
+	void release();
+
+	void beginFrame();
+	void endFrame();
+
+	void beginCpu(ProfilerPhase phase);
+	void endCpu(ProfilerPhase phase);
+	void beginGpu(ProfilerPhase phase);
+	void endGpu(ProfilerPhase phase);
+
+	// Average over the history in milliseconds, GPU times are 0 without queries
+	float getCpuAverage(ProfilerPhase phase) const;
+	float getGpuAverage(ProfilerPhase phase) const;
+	float getFrameAverage() const;
+
+	// Take over the history of another profiler, for a UI built on another thread
+	void copyHistory(const Profiler& other);
+
+	// Write the whole history as CSV, one row per frame, oldest first
+	bool exportCsv(const char* path) const;
+
+	// The "Performance" window
+	void showWindow(bool* open);
+
+	static const char* getPhaseName(ProfilerPhase phase);
+
+private:
+	typedef std::chrono::high_resolution_clock Clock;
+
+	// Ring buffers, "head" is the next frame to write
+	float cpuHistory[PHASE_COUNT][PROFILER_HISTORY];
+	float gpuHistory[PHASE_COUNT][PROFILER_HISTORY];
+	float frameHistory[PROFILER_HISTORY];
+	// Latest GPU result of each phase, stands in for frames still in flight
+	float gpuLatest[PHASE_COUNT];
+	int head;
+	int frames;
+
+	Clock::time_point frameStart;
+	Clock::time_point cpuStart[PHASE_COUNT];
+	double cpuCurrent[PHASE_COUNT];
+
+	GLuint queries[PHASE_COUNT][PROFILER_QUERY_FRAMES];
+	bool queryIssued[PHASE_COUNT][PROFILER_QUERY_FRAMES];
+	// History index of the frame that issued each slot
+	int queryFrame[PROFILER_QUERY_FRAMES];
+	int querySlot;
+	bool hasQueries;
+	// Whether the GPU history holds real timings, also true for copies
+	bool hasGpuTimings;
+
+	char exportStatus[128];
+};
+
+/*
+Times the enclosing scope as a CPU phase.
+*/
+class ProfilerScope
+{
+public:
+	ProfilerScope(Profiler& profiler, ProfilerPhase phase)
+		: profiler(profiler), phase(phase)
+	{
+		profiler.beginCpu(phase);
+	}
+
+	~ProfilerScope()
+	{
+		profiler.endCpu(phase);
+	}
+
+private:
+	Profiler& profiler;
+	ProfilerPhase phase;
+};
+
+#endif // !PROFILER_H
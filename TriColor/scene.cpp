@@ -0,0 +1,355 @@
+#include "scene.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#include "colorconv.h"
+
+// SSE2 is the baseline on x64, on 32-bit x86 only when the compiler targets it
+#if defined(_M_X64) || defined(__x86_64__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define SCENE_HAS_SSE2
+#include <emmintrin.h>
+#endif
+
+static inline unsigned int xorshift32(unsigned int& state)
+{
+	state ^= state << 13;
+	state ^= state >> 17;
+	state ^= state << 5;
+	return state;
+}
+
+/*
+One axis of the movement: p += v * dt, and past the border p is mirrored back inside and v
+flips. The clamp catches steps longer than the whole border. The SSE2 version evaluates the
+same operations in the same order, results don't depend on where a chunk starts.
+*/
+static void moveAxis(float* position, float* velocity, size_t count, float dt)
+{
+	size_t i = 0;
+
+#ifdef SCENE_HAS_SSE2
+	const __m128 step = _mm_set1_ps(dt);
+	const __m128 border = _mm_set1_ps(SCENE_BORDER);
+	const __m128 negativeBorder = _mm_set1_ps(-SCENE_BORDER);
+	const __m128 mirror = _mm_set1_ps(2.0f * SCENE_BORDER);
+	const __m128 negativeMirror = _mm_set1_ps(-2.0f * SCENE_BORDER);
+	const __m128 sign = _mm_set1_ps(-0.0f);
+
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 v = _mm_loadu_ps(velocity + i);
+		__m128 p = _mm_add_ps(_mm_loadu_ps(position + i), _mm_mul_ps(v, step));
+
+		__m128 over = _mm_cmpgt_ps(p, border);
+		__m128 under = _mm_cmplt_ps(p, negativeBorder);
+		__m128 outside = _mm_or_ps(over, under);
+		__m128 edge = _mm_or_ps(_mm_and_ps(over, mirror), _mm_and_ps(under, negativeMirror));
+
+		p = _mm_or_ps(_mm_and_ps(outside, _mm_sub_ps(edge, p)), _mm_andnot_ps(outside, p));
+		p = _mm_min_ps(_mm_max_ps(p, negativeBorder), border);
+		v = _mm_xor_ps(v, _mm_and_ps(outside, sign));
+
+		_mm_storeu_ps(position + i, p);
+		_mm_storeu_ps(velocity + i, v);
+	}
+#endif
+
+	for (; i < count; i++)
+	{
+		float v = velocity[i];
+		float p = position[i] + v * dt;
+
+		if (p > SCENE_BORDER)
+		{
+			p = 2.0f * SCENE_BORDER - p;
+			v = -v;
+		}
+		else if (p < -SCENE_BORDER)
+		{
+			p = -2.0f * SCENE_BORDER - p;
+			v = -v;
+		}
+
+		position[i] = std::min(std::max(p, -SCENE_BORDER), SCENE_BORDER);
+		velocity[i] = v;
+	}
+}
+
+static inline float blend(float from, float to, float alpha)
+{
+	return from + (to - from) * alpha;
+}
+
+Scene::Scene()
+{
+}
+
+void Scene::resize(size_t count)
+{
+	x.resize(count);
+	y.resize(count);
+	previousX.resize(count);
+	previousY.resize(count);
+	velocityX.resize(count);
+	velocityY.resize(count);
+	phase.resize(count);
+	red.resize(count);
+	green.resize(count);
+	blue.resize(count);
+
+	// Positions and tints come from the same sequence as always, so layouts stay the same.
+	// Velocities have their own, adding them didn't move anything.
+	unsigned int seed = 0x9E3779B9u;
+	unsigned int velocitySeed = 0x85EBCA6Bu;
+	for (size_t i = 0; i < count; i++)
+	{
+		// Golden ratio in 0.32 fixed point, TriangleVertex.glsl derives the same phase from gl_InstanceID
+		phase[i] = (float)(((unsigned int)i * 2654435769u) >> 8) / 16777216.0f;
+
+		if (i == 0)
+		{
+			x[i] = y[i] = 0.0f;
+			velocityX[i] = velocityY[i] = 0.0f;
+			red[i] = green[i] = blue[i] = 1.0f;
+			continue;
+		}
+
+		float random[5];
+		for (int j = 0; j < 5; j++)
+			random[j] = (float)(xorshift32(seed) & 0xFFFFFF) / (float)0xFFFFFF;
+
+		x[i] = random[0] - 0.5f;
+		y[i] = random[1] - 0.5f;
+		red[i] = random[2];
+		green[i] = random[3];
+		blue[i] = random[4];
+
+		velocityX[i] = ((float)(xorshift32(velocitySeed) & 0xFFFFFF) / (float)0xFFFFFF - 0.5f) * 2.0f * SCENE_DRIFT_SPEED;
+		velocityY[i] = ((float)(xorshift32(velocitySeed) & 0xFFFFFF) / (float)0xFFFFFF - 0.5f) * 2.0f * SCENE_DRIFT_SPEED;
+	}
+
+	previousX = x;
+	previousY = y;
+}
+
+size_t Scene::size() const
+{
+	return x.size();
+}
+
+void Scene::step(float dt, JobSystem& jobs)
+{
+	jobs.parallelFor(0, size(), SCENE_GRAIN, [this, dt](size_t begin, size_t end)
+	{
+		size_t bytes = (end - begin) * sizeof(float);
+		memcpy(&previousX[begin], &x[begin], bytes);
+		memcpy(&previousY[begin], &y[begin], bytes);
+
+		moveAxis(&x[begin], &velocityX[begin], end - begin, dt);
+		moveAxis(&y[begin], &velocityY[begin], end - begin, dt);
+	});
+}
+
+void Scene::writeInstances(TriangleInstance* out, float alpha, JobSystem& jobs) const
+{
+	jobs.parallelFor(0, size(), SCENE_GRAIN, [this, out, alpha](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			out[i].offset[0] = blend(previousX[i], x[i], alpha);
+			out[i].offset[1] = blend(previousY[i], y[i], alpha);
+			out[i].tint[0] = red[i];
+			out[i].tint[1] = green[i];
+			out[i].tint[2] = blue[i];
+		}
+	});
+}
+
+void Scene::writeAnimatedInstances(TriangleInstance* out, float alpha, float wave, JobSystem& jobs) const
+{
+	jobs.parallelFor(0, size(), SCENE_GRAIN, [this, out, alpha, wave](size_t begin, size_t end)
+	{
+		// Converted a block at a time, the HSV arrays stay in L1 and nothing is stored per entity
+		float hue[SCENE_BLOCK], r[SCENE_BLOCK], g[SCENE_BLOCK], b[SCENE_BLOCK];
+		float ones[SCENE_BLOCK];
+		std::fill(ones, ones + SCENE_BLOCK, 1.0f);
+
+		for (size_t block = begin; block < end; block += SCENE_BLOCK)
+		{
+			size_t count = std::min((size_t)SCENE_BLOCK, end - block);
+
+			for (size_t i = 0; i < count; i++)
+				hue[i] = wave + phase[block + i];
+
+			hsv2rgb(hue, ones, ones, r, g, b, count);
+
+			for (size_t i = 0; i < count; i++)
+			{
+				TriangleInstance& instance = out[block + i];
+				instance.offset[0] = blend(previousX[block + i], x[block + i], alpha);
+				instance.offset[1] = blend(previousY[block + i], y[block + i], alpha);
+				instance.tint[0] = r[i];
+				instance.tint[1] = g[i];
+				instance.tint[2] = b[i];
+			}
+		}
+	});
+}
+
+size_t Scene::writeVisibleInstances(TriangleInstance* out, float alpha, bool animate, float wave,
+	const SceneView& view, JobSystem& jobs) const
+{
+	if (view.scale < view.minScale)
+		return 0;
+
+	size_t count = size();
+	size_t blocks = (count + SCENE_GRAIN - 1) / SCENE_GRAIN;
+	visibleCounts.resize(blocks);
+
+	float limit = 1.0f + 0.5f * view.scale;
+	auto isVisible = [this, alpha, &view, limit](size_t i)
+	{
+		float centerX = blend(previousX[i], x[i], alpha) + view.position[0];
+		float centerY = blend(previousY[i], y[i], alpha) + view.position[1];
+		return fabsf(centerX) <= limit && fabsf(centerY) <= limit;
+	};
+
+	// Two passes so the survivors keep their order: count per block, then each block writes
+	// from where the blocks before it end
+	jobs.parallelFor(0, blocks, 1, [&](size_t begin, size_t end)
+	{
+		for (size_t block = begin; block < end; block++)
+		{
+			size_t last = std::min((block + 1) * SCENE_GRAIN, count);
+			size_t visible = 0;
+			for (size_t i = block * SCENE_GRAIN; i < last; i++)
+				visible += isVisible(i) ? 1 : 0;
+
+			visibleCounts[block] = visible;
+		}
+	});
+
+	size_t total = 0;
+	for (size_t block = 0; block < blocks; block++)
+	{
+		size_t visible = visibleCounts[block];
+		visibleCounts[block] = total;
+		total += visible;
+	}
+
+	jobs.parallelFor(0, blocks, 1, [&](size_t begin, size_t end)
+	{
+		// Survivors are gathered a SCENE_BLOCK at a time, only they are converted to RGB
+		size_t index[SCENE_BLOCK];
+		float hue[SCENE_BLOCK], r[SCENE_BLOCK], g[SCENE_BLOCK], b[SCENE_BLOCK];
+		float ones[SCENE_BLOCK];
+		std::fill(ones, ones + SCENE_BLOCK, 1.0f);
+
+		for (size_t block = begin; block < end; block++)
+		{
+			TriangleInstance* target = out + visibleCounts[block];
+			size_t last = std::min((block + 1) * SCENE_GRAIN, count);
+
+			for (size_t i = block * SCENE_GRAIN; i < last;)
+			{
+				size_t gathered = 0;
+				for (; i < last && gathered < SCENE_BLOCK; i++)
+				{
+					if (isVisible(i))
+						index[gathered++] = i;
+				}
+
+				if (animate)
+				{
+					for (size_t k = 0; k < gathered; k++)
+						hue[k] = wave + phase[index[k]];
+
+					hsv2rgb(hue, ones, ones, r, g, b, gathered);
+				}
+
+				for (size_t k = 0; k < gathered; k++)
+				{
+					size_t j = index[k];
+					target[k].offset[0] = blend(previousX[j], x[j], alpha);
+					target[k].offset[1] = blend(previousY[j], y[j], alpha);
+					target[k].tint[0] = animate ? r[k] : red[j];
+					target[k].tint[1] = animate ? g[k] : green[j];
+					target[k].tint[2] = animate ? b[k] : blue[j];
+				}
+
+				target += gathered;
+			}
+		}
+	});
+
+	return total;
+}
+
+SceneEntity Scene::getEntity(size_t index, float alpha) const
+{
+	SceneEntity entity;
+	entity.position[0] = blend(previousX[index], x[index], alpha);
+	entity.position[1] = blend(previousY[index], y[index], alpha);
+	entity.velocity[0] = velocityX[index];
+	entity.velocity[1] = velocityY[index];
+	entity.tint[0] = red[index];
+	entity.tint[1] = green[index];
+	entity.tint[2] = blue[index];
+	entity.phase = phase[index];
+	return entity;
+}
+
+// Average milliseconds of "work", repeated for at least 0.1 s
+template<typename Work>
+static double timeAverageMs(Work work)
+{
+	typedef std::chrono::high_resolution_clock Clock;
+
+	int runs = 0;
+	Clock::time_point start = Clock::now();
+	double elapsed = 0.0;
+	do
+	{
+		work();
+		runs++;
+		elapsed = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	} while (elapsed < 100.0 || runs < 3);
+
+	return elapsed / runs;
+}
+
+void benchmarkScene(int threads)
+{
+	JobSystem single(0);
+	JobSystem pool(threads > 0 ? threads - 1 : -1);
+
+	printf("Scene update, 1 and %d threads, ns per entity\n", pool.getThreadCount());
+	printf("%-10s %10s %10s %10s %10s %10s %10s\n", "Entities", "Step 1", "Step N", "Write 1", "Write N", "Anim 1", "Anim N");
+
+	Scene scene;
+	std::vector<TriangleInstance> instances;
+
+	for (size_t count = 1000; count <= 10000000; count *= 10)
+	{
+		scene.resize(count);
+		instances.resize(count);
+		TriangleInstance* out = instances.data();
+
+		JobSystem* systems[2] = { &single, &pool };
+		double ns[3][2];
+		for (int s = 0; s < 2; s++)
+		{
+			JobSystem& jobs = *systems[s];
+			ns[0][s] = timeAverageMs([&]() { scene.step(1.0f / 60.0f, jobs); }) * 1e6 / count;
+			ns[1][s] = timeAverageMs([&]() { scene.writeInstances(out, 0.5f, jobs); }) * 1e6 / count;
+			ns[2][s] = timeAverageMs([&]() { scene.writeAnimatedInstances(out, 0.5f, 0.25f, jobs); }) * 1e6 / count;
+		}
+
+		printf("%-10zu %10.3f %10.3f %10.3f %10.3f %10.3f %10.3f\n", count,
+			ns[0][0], ns[0][1], ns[1][0], ns[1][1], ns[2][0], ns[2][1]);
+	}
+}
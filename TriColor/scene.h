@@ -0,0 +1,113 @@
+#pragma once
+
+#ifndef SCENE_H
+#define SCENE_H
+#include <cstddef>
+#include <vector>
+
+#include "jobs.h"
+
+// Entities keep inside [-SCENE_BORDER, SCENE_BORDER] on both axes, around the scene position
+#define SCENE_BORDER 0.5f
+// Fastest drift of an entity, units per second on each axis
+#define SCENE_DRIFT_SPEED 0.25f
+// Entities per parallelFor chunk, and per block of the color kernel (kept on the stack)
+#define SCENE_GRAIN 16384
+#define SCENE_BLOCK 256
+
+/*
+Per-instance data of a triangle, laid out the same way as attribute 2 and 3 in TriangleVertex.glsl.
+*/
+struct TriangleInstance
+{
+	float offset[2];
+	float tint[3];
+};
+
+/*
+What culling tests the instances against: the scene is drawn at "position" with every triangle
+at "scale", and triangles below "minScale" are too small to be worth drawing. A triangle spans
+half its scale around its offset, it's visible while any of that is inside [-1, 1].
+*/
+struct SceneView
+{
+	float position[2];
+	float scale;
+	float minScale;
+};
+
+/*
+Everything about one entity, for showing it.
+*/
+struct SceneEntity
+{
+	float position[2];
+	float velocity[2];
+	float tint[3];
+	float phase;
+};
+
+/*
+The triangles as a structure of arrays, one array per field, so every kernel streams through
+memory and vectorizes. Updates run in chunks over a JobSystem and write the instance data
+straight into the upload buffer, nothing is allocated per entity or per frame.
+
+Entity 0 sits in the middle with a neutral tint and never moves, so a scene of 1 looks the same
+as the single triangle from before. The rest are scattered with a fixed seed.
+*/
+class Scene
+{
+public:
+	Scene();
+
+	// Regenerate the scene with "count" entities
+	void resize(size_t count);
+	size_t size() const;
+
+	// Move every entity by its velocity over "dt" seconds, bouncing off the border.
+	// The positions before the step are kept for writeInstances to blend from.
+	void step(float dt, JobSystem& jobs);
+
+	/*
+	Write all instances to "out", at "alpha" between the previous and the current step.
+	The animated version tints each entity by hue "wave" plus its own phase, the same
+	colors TriangleVertex.glsl computes from uTime.
+	*/
+	void writeInstances(TriangleInstance* out, float alpha, JobSystem& jobs) const;
+	void writeAnimatedInstances(TriangleInstance* out, float alpha, float wave, JobSystem& jobs) const;
+
+	/*
+	Write only the instances visible in "view", packed and in order, and return how many.
+	The CPU side of CullCompute.glsl: with "animate" the tints are the wave at "wave".
+	*/
+	size_t writeVisibleInstances(TriangleInstance* out, float alpha, bool animate, float wave,
+		const SceneView& view, JobSystem& jobs) const;
+
+	// Entity "index" at "alpha" between the previous and the current step
+	SceneEntity getEntity(size_t index, float alpha) const;
+
+	// Positions after the last step and before it, size() of each
+	const float* getX() const { return x.data(); }
+	const float* getY() const { return y.data(); }
+	const float* getPreviousX() const { return previousX.data(); }
+	const float* getPreviousY() const { return previousY.data(); }
+
+private:
+	std::vector<float> x, y;
+	std::vector<float> previousX, previousY;
+	std::vector<float> velocityX, velocityY;
+	// Hue offset of each entity, spread by the golden ratio so neighbours differ
+	std::vector<float> phase;
+	// Static tint, used while the colors aren't animated
+	std::vector<float> red, green, blue;
+	// Survivors per SCENE_GRAIN block in writeVisibleInstances, kept to not allocate every frame
+	mutable std::vector<size_t> visibleCounts;
+};
+
+/*
+Time step() and both writeInstances() from 10^3 to 10^7 entities, on one thread and on
+"threads" (0 for every core), printed to stdout.
+*/
+void benchmarkScene(int threads);
+
+#endif // !SCENE_H
@@ -1,100 +1,593 @@
 #include "shader.h"
+#include "glextensions.h"
+#include "shadercompiler.h"
+#include "log.h"
 
-Shader::Shader(string vertexPath, string fragmentPath)
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+
+// Header of a file in SHADER_CACHE_DIR, followed by "length" bytes of program binary
+struct ShaderBinaryHeader
+{
+	char magic[4];
+	unsigned int format;
+	unsigned int length;
+};
+
+/*
+Info log of a shader or program object.
+*/
+static string getInfoLog(unsigned int object, bool isProgram)
 {
-	// Retrieve the vertex/fragment source code from filepath.
+	int length = 0;
+	if (isProgram)
+		glGetProgramiv(object, GL_INFO_LOG_LENGTH, &length);
+	else
+		glGetShaderiv(object, GL_INFO_LOG_LENGTH, &length);
+
+	if (length <= 0)
+		return string();
+
+	std::vector<char> infoLog(length);
+	if (isProgram)
+		glGetProgramInfoLog(object, length, NULL, infoLog.data());
+	else
+		glGetShaderInfoLog(object, length, NULL, infoLog.data());
+
+	return string(infoLog.data());
+}
+
+Shader::Shader(ShaderLibrary& library, const string& vertexPath, const string& fragmentPath,
+	const ShaderDefines& defines)
+{
+	this->ID = 0;
+	this->library = &library;
+	this->vertexPath = vertexPath;
+	this->fragmentPath = fragmentPath;
+	this->defines = defines;
+
+	uniformUploads = 0;
+	uniformSkips = 0;
+	fromBinaryCache = false;
+	status = SHADER_FAILED;
+
+	std::shared_ptr<ShaderBuild> build = std::make_shared<ShaderBuild>();
 	string vertexCode, fragmentCode;
-	std::ifstream vShaderFile, fShaderFile;
+	if (!readSources(*build, vertexCode, fragmentCode))
+	{
+		errorLog = build->error;
+		return;
+	}
+
+	files = build->files;
+	fileLegend = build->fileLegend;
+
+	// Skip compiling if the driver accepts the program from a previous run
+	if (!build->cachePath.empty())
+	{
+		this->ID = loadBinary(build->cachePath);
+		if (ID != 0)
+		{
+			fromBinaryCache = true;
+			status = SHADER_READY;
+			loadUniforms();
+			return;
+		}
+	}
+
+	// The first program has nothing to fall back to, so wait for it
+	compile(*build, vertexCode, fragmentCode);
+	pending = build;
+	finishCompile();
+}
+
+Shader::~Shader()
+{
+	if (pending)
+	{
+		// Let the worker get done with it first
+		if (pending->onWorker)
+			library->getCompiler()->wait();
+		deleteBuild(*pending);
+	}
+
+	if (ID != 0)
+		glDeleteProgram(ID);
+}
+
+void Shader::use()
+{
+	glUseProgram(this->ID);
+}
+
+void Shader::reload()
+{
+	LOG_DEBUG("Reloading shader %s, %s", vertexPath.c_str(), fragmentPath.c_str());
+
+	std::shared_ptr<ShaderBuild> build = std::make_shared<ShaderBuild>();
+	ShaderCompiler* compiler = library->getCompiler();
+	if (compiler != NULL && compiler->isRunning())
+	{
+		// A build still in flight is dropped, the newer sources win. The worker may still be
+		// on it, so it deletes the objects when it gets to this one.
+		std::shared_ptr<ShaderBuild> previous = pending;
+		build->onWorker = true;
+		compiler->submit([this, build, previous]()
+		{
+			if (previous)
+				deleteBuild(*previous);
 
-	// Ensure ifstream objects can throw exceptions.
-	vShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-	fShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+			string vertexCode, fragmentCode;
+			if (readSources(*build, vertexCode, fragmentCode))
+			{
+				compile(*build, vertexCode, fragmentCode);
 
-	// Debug
-	//printf("Vertex path: %s\n", vertexPath.c_str());
-	//printf("Fragment path: %s\n", fragmentPath.c_str());
+				// Waits for the link, on this thread only
+				int linked = GL_FALSE;
+				glGetProgramiv(build->program, GL_LINK_STATUS, &linked);
+				if (linked && !build->cachePath.empty())
+					saveBinary(build->program, build->cachePath);
+				build->cachePath.clear();
+			}
 
-	try
+			// The objects must be complete in the render thread's context before it looks
+			glFinish();
+			build->done = true;
+		});
+	}
+	else
 	{
-		// Open files.
-		vShaderFile.open(vertexPath.c_str());
-		fShaderFile.open(fragmentPath.c_str());
+		if (pending)
+			deleteBuild(*pending);
+
+		string vertexCode, fragmentCode;
+		if (readSources(*build, vertexCode, fragmentCode))
+			compile(*build, vertexCode, fragmentCode);
+		build->done = true;
+	}
 
-		std::stringstream vShaderStream, fShaderStream;
+	pending = build;
+	status = SHADER_COMPILING;
+}
 
-		// Read file's contents into streams.
-		vShaderStream << vShaderFile.rdbuf();
-		fShaderStream << fShaderFile.rdbuf();
+bool Shader::update()
+{
+	if (!pending || !pending->done)
+		return false;
+
+	// On this thread the driver may still be busy, with parallel compile check without blocking
+	if (!pending->onWorker && pending->program != 0 && GLExt.parallelShaderCompile)
+	{
+		int done = GL_FALSE;
+		glGetProgramiv(pending->program, GL_COMPLETION_STATUS_KHR, &done);
+		if (!done)
+			return false;
+	}
+
+	return finishCompile();
+}
 
-		// Close file handlers.
-		vShaderFile.close();
-		fShaderFile.close();
+/*
+Both sources through the library's preprocessor, along with the files they came from and the
+binary cache path. Fills the build's "error" if a file can't be read. Safe on the worker.
+*/
+bool Shader::readSources(ShaderBuild& build, string& vertexCode, string& fragmentCode) const
+{
+	std::vector<string> vertexFiles, fragmentFiles;
+	if (!library->preprocess(vertexPath, defines, vertexCode, vertexFiles, build.error)
+		|| !library->preprocess(fragmentPath, defines, fragmentCode, fragmentFiles, build.error))
+		return false;
 
-		// Convert stream into string.
-		vertexCode = vShaderStream.str();
-		fragmentCode = fShaderStream.str();
+	build.files = vertexFiles;
+	for (const string& file : fragmentFiles)
+	{
+		if (std::find(build.files.begin(), build.files.end(), file) == build.files.end())
+			build.files.push_back(file);
 	}
-	catch (const std::ifstream::failure e)
+
+	// Only worth it once there are includes, otherwise every error is in the stage's own file
+	build.fileLegend.clear();
+	const std::vector<string>* stageFiles[] = { &vertexFiles, &fragmentFiles };
+	const char* stageNames[] = { "Vertex", "Fragment" };
+	for (int stage = 0; stage < 2; stage++)
 	{
-		printf("Error. Faield to read shader files.\n");
+		if (stageFiles[stage]->size() < 2)
+			continue;
+
+		build.fileLegend += string(stageNames[stage]) + " sources:";
+		for (size_t i = 0; i < stageFiles[stage]->size(); i++)
+			build.fileLegend += " " + std::to_string(i) + " " + (*stageFiles[stage])[i];
+		build.fileLegend += "\n";
 	}
 
+	build.cachePath = binaryCachePath(vertexCode, fragmentCode);
+	return true;
+}
+
+/*
+Start compiling and linking the build's program. The current program stays in use until
+finishCompile() has checked the result.
+*/
+void Shader::compile(ShaderBuild& build, const string& vertexCode, const string& fragmentCode) const
+{
 	const char* vShaderCode = vertexCode.c_str();
 	const char* fShaderCode = fragmentCode.c_str();
 
 	//printf("%s\n", vShaderCode);
 
 	// Compile shader.
-	unsigned int vertex, fragment;
-	int success;
-	char infoLog[512];
-
 	// Vertex shader
-	vertex = glCreateShader(GL_VERTEX_SHADER);
-	glShaderSource(vertex, 1, &vShaderCode, NULL);
-	glCompileShader(vertex);
+	build.vertex = glCreateShader(GL_VERTEX_SHADER);
+	glShaderSource(build.vertex, 1, &vShaderCode, NULL);
+	glCompileShader(build.vertex);
 
-	// Print compile errors if any
-	glGetShaderiv(vertex, GL_COMPILE_STATUS, &success);
-	if (!success)
+	// Fragment shader
+	build.fragment = glCreateShader(GL_FRAGMENT_SHADER);
+	glShaderSource(build.fragment, 1, &fShaderCode, NULL);
+	glCompileShader(build.fragment);
+
+	// Shader program
+	build.program = glCreateProgram();
+	if (!build.cachePath.empty())
+		GLExt.ProgramParameteri(build.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	glAttachShader(build.program, build.vertex);
+	glAttachShader(build.program, build.fragment);
+	glLinkProgram(build.program);
+}
+
+void Shader::deleteBuild(ShaderBuild& build)
+{
+	glDeleteShader(build.vertex);
+	glDeleteShader(build.fragment);
+	glDeleteProgram(build.program);
+	build.vertex = build.fragment = build.program = 0;
+}
+
+/*
+Check the pending build and swap its program in if it linked. Blocks if the driver isn't done
+yet, which a build from the worker never is.
+*/
+bool Shader::finishCompile()
+{
+	std::shared_ptr<ShaderBuild> build = pending;
+	pending.reset();
+
+	// The sources couldn't be read
+	if (build->program == 0)
 	{
-		glGetShaderInfoLog(vertex, 512, NULL, infoLog);
-		printf("Error. Vertex shader compilation failed.\n%s\n", infoLog);
+		errorLog = build->error;
+		status = SHADER_FAILED;
+		return false;
 	}
 
-	// Fragment shader
-	fragment = glCreateShader(GL_FRAGMENT_SHADER);
-	glShaderSource(fragment, 1, &fShaderCode, NULL);
-	glCompileShader(fragment);
+	files = build->files;
+	fileLegend = build->fileLegend;
+
+	int success;
+	string log;
 
 	// Print compile errors if any
-	glGetShaderiv(fragment, GL_COMPILE_STATUS, &success);
+	glGetShaderiv(build->vertex, GL_COMPILE_STATUS, &success);
 	if (!success)
 	{
-		glGetShaderInfoLog(fragment, 512, NULL, infoLog);
-		printf("Error. %s\n", infoLog);
+		string infoLog = getInfoLog(build->vertex, false);
+		LOG_ERROR("Vertex shader compilation failed.\n%s", infoLog.c_str());
+		log += "Vertex shader:\n" + infoLog;
 	}
 
-	// Shader program
-	this->ID = glCreateProgram();
-	glAttachShader(ID, vertex);
-	glAttachShader(ID, fragment);
-	glLinkProgram(ID);
+	glGetShaderiv(build->fragment, GL_COMPILE_STATUS, &success);
+	if (!success)
+	{
+		string infoLog = getInfoLog(build->fragment, false);
+		LOG_ERROR("Fragment shader compilation failed.\n%s", infoLog.c_str());
+		log += "Fragment shader:\n" + infoLog;
+	}
 
 	// Print linking errors if any
-	glGetProgramiv(ID, GL_LINK_STATUS, &success);
-	if (!success)
+	glGetProgramiv(build->program, GL_LINK_STATUS, &success);
+	if (!success && log.empty())
 	{
-		glGetProgramInfoLog(ID, 512, NULL, infoLog);
-		printf("Error. %s\n", infoLog);
+		string infoLog = getInfoLog(build->program, true);
+		LOG_ERROR("Shader program linking failed.\n%s", infoLog.c_str());
+		log += "Program:\n" + infoLog;
 	}
 
 	// Delete the shaders as they're linked into our program now and no longer necessary
-	glDeleteShader(vertex);
-	glDeleteShader(fragment);
+	glDeleteShader(build->vertex);
+	glDeleteShader(build->fragment);
+
+	unsigned int program = build->program;
+
+	// Keep the last good program on failure
+	if (!success)
+	{
+		glDeleteProgram(program);
+		errorLog = log + fileLegend;
+		status = SHADER_FAILED;
+		return false;
+	}
+
+	// A build from the worker saved it there already
+	if (!build->cachePath.empty())
+		saveBinary(program, build->cachePath);
+
+	if (ID != 0)
+		glDeleteProgram(ID);
+	this->ID = program;
+
+	errorLog.clear();
+	status = SHADER_READY;
+	fromBinaryCache = false;
+	loadUniforms();
+
+	return true;
 }
 
-void Shader::use()
+/*
+Cache file for this pair of sources on this driver, or an empty string if program binaries
+aren't supported. Any change to the sources, GPU or driver version gives a different file.
+*/
+string Shader::binaryCachePath(const string& vertexCode, const string& fragmentCode) const
 {
-	glUseProgram(this->ID);
+	if (!GLExt.programBinary)
+		return string();
+
+	const char* renderer = (const char*)glGetString(GL_RENDERER);
+	const char* version = (const char*)glGetString(GL_VERSION);
+
+	// FNV-1a, 64 bit
+	unsigned long long hash = 14695981039346656037ull;
+	string driver = string(renderer != NULL ? renderer : "") + '\n' + (version != NULL ? version : "");
+	const string* parts[] = { &vertexCode, &fragmentCode, &driver };
+
+	for (const string* part : parts)
+	{
+		for (unsigned char c : *part)
+		{
+			hash ^= c;
+			hash *= 1099511628211ull;
+		}
+
+		// Separator, so moving text from one source to the other changes the key
+		hash ^= 0xFF;
+		hash *= 1099511628211ull;
+	}
+
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx.bin", hash);
+
+	return string(SHADER_CACHE_DIR) + "/" + name;
+}
+
+unsigned int Shader::loadBinary(const string& path) const
+{
+	std::ifstream file(path.c_str(), std::ios::binary);
+	if (!file.is_open())
+		return 0;
+
+	ShaderBinaryHeader header;
+	if (!file.read((char*)&header, sizeof(header)) || memcmp(header.magic, "TCPB", 4) != 0)
+		return 0;
+
+	// A truncated or corrupt file mustn't make us allocate whatever its length says
+	std::streamoff start = file.tellg();
+	file.seekg(0, std::ios::end);
+	std::streamoff remaining = file.tellg() - start;
+	file.seekg(start);
+	if (header.length == 0 || remaining != (std::streamoff)header.length)
+		return 0;
+
+	std::vector<char> binary(header.length);
+	if (!file.read(binary.data(), binary.size()))
+		return 0;
+
+	unsigned int program = glCreateProgram();
+	GLExt.ProgramBinary(program, (GLenum)header.format, binary.data(), (GLsizei)binary.size());
+
+	// Drivers reject binaries after an update, that's not an error, just compile again
+	int success;
+	glGetProgramiv(program, GL_LINK_STATUS, &success);
+	if (!success)
+	{
+		glDeleteProgram(program);
+		return 0;
+	}
+
+	return program;
+}
+
+void Shader::saveBinary(unsigned int program, const string& path) const
+{
+	int length = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0)
+		return;
+
+	ShaderBinaryHeader header = { { 'T', 'C', 'P', 'B' }, 0, 0 };
+	std::vector<char> binary(length);
+
+	GLenum format = 0;
+	GLsizei written = 0;
+	GLExt.GetProgramBinary(program, length, &written, &format, binary.data());
+	if (written <= 0)
+		return;
+
+	header.format = format;
+	header.length = (unsigned int)written;
+
+	std::error_code error;
+	std::filesystem::create_directories(SHADER_CACHE_DIR, error);
+
+	// Written aside and renamed over the entry, a crash mid-write never leaves half a binary behind
+	string tempPath = path + ".tmp";
+	{
+		std::ofstream file(tempPath.c_str(), std::ios::binary | std::ios::trunc);
+		if (file.is_open())
+		{
+			file.write((const char*)&header, sizeof(header));
+			file.write(binary.data(), written);
+			file.close();
+		}
+
+		if (!file)
+		{
+			LOG_WARNING("Failed to write shader cache file %s", path.c_str());
+			std::filesystem::remove(tempPath, error);
+			return;
+		}
+	}
+
+	std::filesystem::rename(tempPath, path, error);
+	if (error)
+	{
+		LOG_WARNING("Failed to write shader cache file %s (%s)", path.c_str(), error.message().c_str());
+		std::filesystem::remove(tempPath, error);
+	}
+}
+
+/*
+FNV-1a hash of a uniform name.
+*/
+static unsigned int hashUniformName(const char* name)
+{
+	unsigned int hash = 2166136261u;
+	for (; *name != '\0'; name++)
+	{
+		hash ^= (unsigned char)*name;
+		hash *= 16777619u;
+	}
+
+	return hash;
+}
+
+void Shader::loadUniforms()
+{
+	uniforms.clear();
+
+	int count = 0, maxNameLength = 0;
+	glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+	glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxNameLength);
+
+	// Keep the table at most half full so probe sequences stay short
+	size_t capacity = 8;
+	while (capacity < (size_t)count * 2)
+		capacity *= 2;
+	uniforms.resize(capacity);
+
+	std::vector<char> name(maxNameLength + 1);
+	for (int i = 0; i < count; i++)
+	{
+		int size = 0;
+		GLenum type = 0;
+		glGetActiveUniform(ID, i, (GLsizei)name.size(), NULL, &size, &type, name.data());
+
+		// Members of uniform blocks don't have a location
+		int location = glGetUniformLocation(ID, name.data());
+		if (location < 0)
+			continue;
+
+		// Arrays are reported as "name[0]", look them up by their plain name
+		string uniformName(name.data());
+		size_t bracket = uniformName.find('[');
+		if (bracket != string::npos)
+			uniformName.resize(bracket);
+
+		unsigned int hash = hashUniformName(uniformName.c_str());
+		size_t index = hash & (capacity - 1);
+		while (!uniforms[index].name.empty())
+			index = (index + 1) & (capacity - 1);
+
+		ShaderUniform& uniform = uniforms[index];
+		uniform.name = uniformName;
+		uniform.hash = hash;
+		uniform.location = location;
+		uniform.type = type;
+		uniform.known = false;
+	}
+}
+
+const ShaderUniform* Shader::findUniform(const char* name) const
+{
+	if (uniforms.empty())
+		return NULL;
+
+	size_t mask = uniforms.size() - 1;
+	unsigned int hash = hashUniformName(name);
+
+	for (size_t index = hash & mask; !uniforms[index].name.empty(); index = (index + 1) & mask)
+	{
+		const ShaderUniform& uniform = uniforms[index];
+		if (uniform.hash == hash && uniform.name == name)
+			return &uniform;
+	}
+
+	return NULL;
+}
+
+ShaderUniform* Shader::findUniform(const char* name)
+{
+	return const_cast<ShaderUniform*>(static_cast<const Shader*>(this)->findUniform(name));
+}
+
+int Shader::getLocation(const char* name) const
+{
+	const ShaderUniform* uniform = findUniform(name);
+	return uniform != NULL ? uniform->location : -1;
+}
+
+bool Shader::updateShadow(ShaderUniform* uniform, const void* value, int count)
+{
+	if (uniform->known && memcmp(&uniform->value, value, count * 4) == 0)
+	{
+		uniformSkips++;
+		return false;
+	}
+
+	memcpy(&uniform->value, value, count * 4);
+	uniform->known = true;
+	uniformUploads++;
+
+	return true;
+}
+
+void Shader::set(const char* name, int x)
+{
+	ShaderUniform* uniform = findUniform(name);
+	if (uniform != NULL && updateShadow(uniform, &x, 1))
+		glUniform1i(uniform->location, x);
+}
+
+void Shader::set(const char* name, float x)
+{
+	ShaderUniform* uniform = findUniform(name);
+	if (uniform != NULL && updateShadow(uniform, &x, 1))
+		glUniform1f(uniform->location, x);
+}
+
+void Shader::set(const char* name, float x, float y)
+{
+	float value[] = { x, y };
+
+	ShaderUniform* uniform = findUniform(name);
+	if (uniform != NULL && updateShadow(uniform, value, 2))
+		glUniform2f(uniform->location, x, y);
+}
+
+void Shader::set(const char* name, float x, float y, float z)
+{
+	float value[] = { x, y, z };
+
+	ShaderUniform* uniform = findUniform(name);
+	if (uniform != NULL && updateShadow(uniform, value, 3))
+		glUniform3f(uniform->location, x, y, z);
+}
+
+void Shader::set(const char* name, float x, float y, float z, float w)
+{
+	float value[] = { x, y, z, w };
+
+	ShaderUniform* uniform = findUniform(name);
+	if (uniform != NULL && updateShadow(uniform, value, 4))
+		glUniform4f(uniform->location, x, y, z, w);
 }
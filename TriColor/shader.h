@@ -1,22 +1,157 @@
 #pragma once
 
 #ifndef SHADER_H
+#define SHADER_H
 #include <glad/glad.h>
 
+#include <atomic>
 #include <iostream>
 #include <fstream>
+#include <memory>
 #include <sstream>
+#include <vector>
+
+#include "shaderlibrary.h"
+
+// Directory for linked program binaries, relative to the working directory
+#define SHADER_CACHE_DIR "shadercache"
 
 typedef std::string string;
 
+/*
+An active uniform of the program. "value" shadows what was last uploaded through Shader::set
+so repeated uploads of the same value can be skipped.
+*/
+struct ShaderUniform
+{
+	string name;
+	unsigned int hash;
+	int location;
+	GLenum type;
+	bool known;
+	union
+	{
+		float f[4];
+		int i[4];
+	} value;
+};
+
+enum ShaderStatus
+{
+	SHADER_READY,
+	SHADER_COMPILING,
+	SHADER_FAILED
+};
+
+/*
+A compile in flight. Built on the library's ShaderCompiler when it has one, the render thread
+may only look at it once "done" is set.
+*/
+struct ShaderBuild
+{
+	unsigned int vertex;
+	unsigned int fragment;
+	unsigned int program;
+	// Where to save the linked binary, empty to skip it
+	string cachePath;
+	// Read with the sources, they replace the shader's once the build is finished
+	std::vector<string> files;
+	string fileLegend;
+	// Set when the sources couldn't be read, nothing was compiled then
+	string error;
+	bool onWorker;
+	std::atomic<bool> done;
+};
+
+/*
+A vertex/fragment program built from source files through a ShaderLibrary, which resolves
+includes and adds the variant's defines.
+*/
 class Shader
 {
 public:
 	unsigned int ID;
 
-	Shader(string vertexPath, string fragmentPath);
+	Shader(ShaderLibrary& library, const string& vertexPath, const string& fragmentPath,
+		const ShaderDefines& defines = ShaderDefines());
+	// Deletes the program, so the context must still be current. ShaderLibrary::release()
+	// destroys its shaders before the app tears the context down.
+	~Shader();
+
+	Shader(const Shader&) = delete;
+	Shader& operator=(const Shader&) = delete;
 
 	void use();
+
+	// Start recompiling from the files this shader was created from. "ID" keeps the last
+	// good program until update() swaps in the new one. ShaderLibrary::reload() also makes
+	// sure the files are read from disk again. With a ShaderCompiler the files are read and
+	// compiled on its thread, otherwise here.
+	void reload();
+	// Call once per frame. Returns true when a reloaded program was swapped in. Never waits
+	// with a ShaderCompiler or GL_KHR_parallel_shader_compile. Without either, the fallback
+	// when no shared context can be made, the frame after a reload waits for the link.
+	bool update();
+
+	ShaderStatus getStatus() const { return status; }
+	// Compile/link errors of the last attempt, empty if it succeeded
+	const string& getErrorLog() const { return errorLog; }
+
+	// Location of an active uniform, or -1. Looked up in the table built after linking.
+	int getLocation(const char* name) const;
+
+	// Typed uniform setters. The program must be in use, uploads are skipped when the
+	// value matches the last one set through these functions.
+	void set(const char* name, int x);
+	void set(const char* name, float x);
+	void set(const char* name, float x, float y);
+	void set(const char* name, float x, float y, float z);
+	void set(const char* name, float x, float y, float z, float w);
+
+	// True when the program was loaded from the binary cache instead of compiled
+	bool isFromBinaryCache() const { return fromBinaryCache; }
+
+	// Number of glUniform* calls made and skipped by the setters so far
+	unsigned int getUniformUploads() const { return uniformUploads; }
+	unsigned int getUniformSkips() const { return uniformSkips; }
+
+	const ShaderDefines& getDefines() const { return defines; }
+	// Files the current sources were read from, includes too
+	const std::vector<string>& getFiles() const { return files; }
+
+private:
+	ShaderLibrary* library;
+	string vertexPath;
+	string fragmentPath;
+	ShaderDefines defines;
+	std::vector<string> files;
+	// Which file each #line source number stands for, added to error logs
+	string fileLegend;
+	ShaderStatus status;
+	string errorLog;
+
+	// Compile in flight, NULL if there is none. Shared with the worker building it.
+	std::shared_ptr<ShaderBuild> pending;
+
+	// Open addressing table, the size is a power of two and at most half full
+	std::vector<ShaderUniform> uniforms;
+	unsigned int uniformUploads;
+	unsigned int uniformSkips;
+	bool fromBinaryCache;
+
+	bool readSources(ShaderBuild& build, string& vertexCode, string& fragmentCode) const;
+	void compile(ShaderBuild& build, const string& vertexCode, const string& fragmentCode) const;
+	static void deleteBuild(ShaderBuild& build);
+	bool finishCompile();
+
+	string binaryCachePath(const string& vertexCode, const string& fragmentCode) const;
+	unsigned int loadBinary(const string& path) const;
+	void saveBinary(unsigned int program, const string& path) const;
+
+	void loadUniforms();
+	ShaderUniform* findUniform(const char* name);
+	const ShaderUniform* findUniform(const char* name) const;
+	bool updateShadow(ShaderUniform* uniform, const void* value, int count);
 };
 
-#endif // !SHADER_H
\ No newline at end of file
+#endif // !SHADER_H
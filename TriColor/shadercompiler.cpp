@@ -0,0 +1,95 @@
+#include "shadercompiler.h"
+#include "log.h"
+
+ShaderCompiler::ShaderCompiler()
+{
+	context = NULL;
+	running = false;
+	busy = false;
+}
+
+ShaderCompiler::~ShaderCompiler()
+{
+	stop();
+}
+
+bool ShaderCompiler::start(GLFWwindow* window)
+{
+	if (context != NULL)
+		return true;
+
+	// Same version and profile hints as the app's window, only never shown
+	glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+	context = glfwCreateWindow(1, 1, "Shader compiler", NULL, window);
+	// Windows made after this one shouldn't come out hidden
+	glfwDefaultWindowHints();
+	if (context == NULL)
+	{
+		LOG_WARNING("No shared context for compiling shaders, reloads compile on the render thread");
+		return false;
+	}
+
+	running = true;
+	thread = std::thread(&ShaderCompiler::run, this);
+	return true;
+}
+
+void ShaderCompiler::stop()
+{
+	if (context == NULL)
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		running = false;
+	}
+	wake.notify_one();
+	thread.join();
+
+	glfwDestroyWindow(context);
+	context = NULL;
+}
+
+void ShaderCompiler::submit(std::function<void()> work)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		queue.push_back(std::move(work));
+	}
+	wake.notify_one();
+}
+
+void ShaderCompiler::wait()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	idle.wait(lock, [this]() { return queue.empty() && !busy; });
+}
+
+void ShaderCompiler::run()
+{
+	glfwMakeContextCurrent(context);
+
+	std::unique_lock<std::mutex> lock(mutex);
+	for (;;)
+	{
+		wake.wait(lock, [this]() { return !queue.empty() || !running; });
+
+		// Whatever is queued still runs when stopping, a Shader may be waiting for it
+		if (queue.empty())
+			break;
+
+		std::function<void()> work = std::move(queue.front());
+		queue.pop_front();
+		busy = true;
+
+		lock.unlock();
+		work();
+		lock.lock();
+
+		busy = false;
+		if (queue.empty())
+			idle.notify_all();
+	}
+
+	glfwMakeContextCurrent(NULL);
+}
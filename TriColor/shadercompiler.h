@@ -0,0 +1,57 @@
+#pragma once
+
+#ifndef SHADERCOMPILER_H
+#define SHADERCOMPILER_H
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+/*
+A thread with a GL context of its own, shared with the app's, for compiling shaders without
+holding up the render thread. It's how reloads stay off the render thread on drivers without
+GL_KHR_parallel_shader_compile, where glLinkProgram or the first status query after it waits
+for the driver.
+
+Work runs in the order it was submitted. Objects made on the worker are only complete in other
+contexts once the worker has called glFinish(), so work signals the render thread after that.
+*/
+class ShaderCompiler
+{
+public:
+	ShaderCompiler();
+	~ShaderCompiler();
+
+	ShaderCompiler(const ShaderCompiler&) = delete;
+	ShaderCompiler& operator=(const ShaderCompiler&) = delete;
+
+	// Create a hidden window sharing objects with "window" and start the thread. Call from the
+	// main thread, GLFW makes windows there only. False if the context can't be made.
+	bool start(GLFWwindow* window);
+	// Finish the queued work and destroy the context, before the app's window goes
+	void stop();
+	bool isRunning() const { return context != NULL; }
+
+	// Run "work" on the worker with its context current
+	void submit(std::function<void()> work);
+	// Return once everything submitted so far has run
+	void wait();
+
+private:
+	GLFWwindow* context;
+	std::thread thread;
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable idle;
+	std::deque<std::function<void()>> queue;
+	bool running;
+	bool busy;
+
+	void run();
+};
+
+#endif // !SHADERCOMPILER_H
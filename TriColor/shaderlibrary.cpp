@@ -0,0 +1,348 @@
+#include "shaderlibrary.h"
+#include "shader.h"
+#include "shadercompiler.h"
+#include "log.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+static unsigned long long hashBytes(const char* data, size_t size)
+{
+	// FNV-1a, 64 bit
+	unsigned long long hash = 14695981039346656037ull;
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= (unsigned char)data[i];
+		hash *= 1099511628211ull;
+	}
+
+	return hash;
+}
+
+// Sorted and without duplicates, so the order defines are given in doesn't make a new variant
+static ShaderDefines normalizeDefines(const ShaderDefines& defines)
+{
+	ShaderDefines sorted = defines;
+	std::sort(sorted.begin(), sorted.end());
+	sorted.erase(std::unique(sorted.begin(), sorted.end()), sorted.end());
+	return sorted;
+}
+
+// Directory part of a path including the separator, empty for a bare file name
+static string directoryOf(const string& path)
+{
+	size_t separator = path.find_last_of("/\\");
+	return separator == string::npos ? string() : path.substr(0, separator + 1);
+}
+
+/*
+The quoted file name if "line" is an #include directive, otherwise an empty string.
+*/
+static string parseInclude(const char* line, const char* end)
+{
+	while (line < end && (*line == ' ' || *line == '\t'))
+		line++;
+
+	static const char directive[] = "#include";
+	size_t length = sizeof(directive) - 1;
+	if ((size_t)(end - line) < length || memcmp(line, directive, length) != 0)
+		return string();
+
+	const char* open = (const char*)memchr(line + length, '"', end - line - length);
+	if (open == NULL)
+		return string();
+
+	const char* close = (const char*)memchr(open + 1, '"', end - open - 1);
+	if (close == NULL)
+		return string();
+
+	return string(open + 1, close);
+}
+
+static bool isVersionLine(const char* line, const char* end)
+{
+	while (line < end && (*line == ' ' || *line == '\t'))
+		line++;
+
+	return end - line >= 8 && memcmp(line, "#version", 8) == 0;
+}
+
+ShaderLibrary::ShaderLibrary()
+{
+	hits = 0;
+	misses = 0;
+	tableStale = false;
+	compiler = NULL;
+}
+
+ShaderLibrary::~ShaderLibrary()
+{
+}
+
+Shader* ShaderLibrary::get(const string& vertexPath, const string& fragmentPath, const ShaderDefines& defines)
+{
+	if (tableStale)
+		rebuildTable();
+
+	ShaderDefines sorted = normalizeDefines(defines);
+	string key = variantKey(vertexPath, fragmentPath, sorted);
+
+	std::unordered_map<string, Variant*>::iterator found = variantTable.find(key);
+	if (found != variantTable.end())
+	{
+		hits++;
+		return found->second->shader.get();
+	}
+
+	misses++;
+
+	Variant* variant = new Variant();
+	variant->vertexPath = vertexPath;
+	variant->fragmentPath = fragmentPath;
+	variant->defines = sorted;
+	variants.push_back(std::unique_ptr<Variant>(variant));
+	variantTable[key] = variant;
+
+	variant->shader.reset(new Shader(*this, vertexPath, fragmentPath, sorted));
+	return variant->shader.get();
+}
+
+string ShaderLibrary::variantKey(const string& vertexPath, const string& fragmentPath, const ShaderDefines& defines)
+{
+	// Missing files hash as 0, the variant is still made and reports the error
+	std::lock_guard<std::mutex> lock(sourceMutex);
+	const SourceFile* vertex = map(vertexPath);
+	const SourceFile* fragment = map(fragmentPath);
+
+	char hashes[40];
+	snprintf(hashes, sizeof(hashes), "%016llx%016llx", vertex != NULL ? vertex->hash : 0ull,
+		fragment != NULL ? fragment->hash : 0ull);
+
+	string key = hashes;
+	for (const string& define : defines)
+		key += ';' + define;
+
+	return key;
+}
+
+const ShaderLibrary::SourceFile* ShaderLibrary::map(const string& path)
+{
+	std::unordered_map<string, std::unique_ptr<SourceFile>>::iterator found = sources.find(path);
+	if (found != sources.end())
+		return found->second.get();
+
+	std::unique_ptr<SourceFile> source(new SourceFile());
+	if (!source->file.open(path))
+		return NULL;
+
+	source->hash = hashBytes(source->file.data(), source->file.size());
+
+	SourceFile* mapped = source.get();
+	sources[path] = std::move(source);
+	return mapped;
+}
+
+bool ShaderLibrary::preprocess(const string& path, const ShaderDefines& defines, string& source,
+	std::vector<string>& files, string& error)
+{
+	source.clear();
+	files.clear();
+
+	string body;
+	{
+		std::lock_guard<std::mutex> lock(sourceMutex);
+		if (!expand(path, body, files, error))
+			return false;
+	}
+
+	if (defines.empty())
+	{
+		source = body;
+		return true;
+	}
+
+	// Defines go right after #version, nothing may come before it
+	string defineLines;
+	for (const string& define : defines)
+	{
+		string line = "#define " + define;
+		size_t equals = line.find('=');
+		if (equals != string::npos)
+			line[equals] = ' ';
+		defineLines += line + '\n';
+	}
+
+	size_t version = 0;
+	size_t lineStart = 0;
+	bool found = false;
+	while (lineStart < body.size())
+	{
+		size_t lineEnd = body.find('\n', lineStart);
+		if (lineEnd == string::npos)
+			lineEnd = body.size();
+
+		if (isVersionLine(body.data() + lineStart, body.data() + lineEnd))
+		{
+			version = lineEnd < body.size() ? lineEnd + 1 : lineEnd;
+			found = true;
+			break;
+		}
+
+		lineStart = lineEnd + 1;
+	}
+
+	if (!found)
+	{
+		source = defineLines + "#line 1 0\n" + body;
+		return true;
+	}
+
+	// Count the lines up to and with #version to carry on numbering after the defines
+	int versionLine = (int)std::count(body.begin(), body.begin() + version, '\n');
+	if (version == body.size() && (body.empty() || body.back() != '\n'))
+		versionLine++;
+
+	source = body.substr(0, version);
+	if (!source.empty() && source.back() != '\n')
+		source += '\n';
+	source += defineLines + "#line " + std::to_string(versionLine + 1) + " 0\n" + body.substr(version);
+
+	return true;
+}
+
+bool ShaderLibrary::expand(const string& path, string& source, std::vector<string>& files, string& error)
+{
+	const SourceFile* file = map(path);
+	if (file == NULL)
+	{
+		error = "Failed to read shader file " + path + ".";
+		LOG_ERROR("Failed to read shader file %s.", path.c_str());
+		return false;
+	}
+
+	int index = (int)files.size();
+	files.push_back(path);
+
+	const char* data = file->file.data();
+	const char* end = data + file->file.size();
+	int lineNumber = 1;
+
+	source.reserve(source.size() + file->file.size());
+
+	for (const char* line = data; line < end; lineNumber++)
+	{
+		const char* lineEnd = (const char*)memchr(line, '\n', end - line);
+		const char* next = lineEnd != NULL ? lineEnd + 1 : end;
+		if (lineEnd == NULL)
+			lineEnd = end;
+
+		string include = parseInclude(line, lineEnd);
+		if (include.empty())
+		{
+			source.append(line, next);
+			if (next == end && lineEnd == end)
+				source += '\n';
+		}
+		else
+		{
+			string includePath = directoryOf(path) + include;
+
+			// Each file once per shader, that also keeps include cycles from going anywhere
+			if (std::find(files.begin(), files.end(), includePath) == files.end())
+			{
+				source += "#line 1 " + std::to_string(files.size()) + "\n";
+				if (!expand(includePath, source, files, error))
+				{
+					error = path + ":" + std::to_string(lineNumber) + ": " + error;
+					return false;
+				}
+			}
+
+			source += "#line " + std::to_string(lineNumber + 1) + " " + std::to_string(index) + "\n";
+		}
+
+		line = next;
+	}
+
+	return true;
+}
+
+void ShaderLibrary::reload()
+{
+	// The files may have changed on disk, they're mapped again when read
+	{
+		std::lock_guard<std::mutex> lock(sourceMutex);
+		sources.clear();
+	}
+
+	for (std::unique_ptr<Variant>& variant : variants)
+		variant->shader->reload();
+
+	// Reading the files for the new keys can wait, reloads keep them off this thread
+	variantTable.clear();
+	tableStale = true;
+}
+
+void ShaderLibrary::release()
+{
+	// Reloads in flight use the shaders and the sources
+	if (compiler != NULL && compiler->isRunning())
+		compiler->wait();
+
+	variantTable.clear();
+	variants.clear();
+	tableStale = false;
+
+	std::lock_guard<std::mutex> lock(sourceMutex);
+	sources.clear();
+}
+
+void ShaderLibrary::rebuildTable()
+{
+	variantTable.clear();
+	for (std::unique_ptr<Variant>& variant : variants)
+	{
+		// The key follows the new contents
+		string key = variantKey(variant->vertexPath, variant->fragmentPath, variant->defines);
+		if (variantTable.find(key) == variantTable.end())
+			variantTable[key] = variant.get();
+	}
+
+	tableStale = false;
+}
+
+bool ShaderLibrary::update()
+{
+	bool swapped = false;
+	for (std::unique_ptr<Variant>& variant : variants)
+		swapped |= variant->shader->update();
+
+	return swapped;
+}
+
+bool ShaderLibrary::isCompiling() const
+{
+	for (const std::unique_ptr<Variant>& variant : variants)
+	{
+		if (variant->shader->getStatus() == SHADER_COMPILING)
+			return true;
+	}
+
+	return false;
+}
+
+std::vector<string> ShaderLibrary::getFiles() const
+{
+	std::vector<string> files;
+	for (const std::unique_ptr<Variant>& variant : variants)
+	{
+		for (const string& file : variant->shader->getFiles())
+		{
+			if (std::find(files.begin(), files.end(), file) == files.end())
+				files.push_back(file);
+		}
+	}
+
+	return files;
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#ifndef SHADERLIBRARY_H
+#define SHADERLIBRARY_H
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "mappedfile.h"
+
+typedef std::string string;
+
+class Shader;
+class ShaderCompiler;
+
+// Preprocessor defines of a shader variant, "NAME" or "NAME=VALUE"
+typedef std::vector<string> ShaderDefines;
+
+/*
+Owns the shader programs of the app and the sources they're built from.
+
+Source files are memory mapped once and shared by every variant that uses them. A variant is
+a vertex/fragment pair plus a set of defines, keyed by the hash of both files and the
+defines, so asking for the same variant again is a table lookup. Variants can be requested
+up front to compile them at startup, and every one is rebuilt on reload().
+
+Sources may use #include "file", resolved relative to the including file and pulled in once
+per shader. #line directives keep error line numbers pointing into the right file, the
+source number is the file's index in the list the error log ends with.
+
+With a ShaderCompiler set, reloads read and compile the sources on its thread, so preprocess()
+may be called from there too.
+*/
+class ShaderLibrary
+{
+public:
+	ShaderLibrary();
+	~ShaderLibrary();
+
+	ShaderLibrary(const ShaderLibrary&) = delete;
+	ShaderLibrary& operator=(const ShaderLibrary&) = delete;
+
+	// The variant for these files and defines, built the first time it's asked for.
+	// Never NULL, check the Shader's status for errors.
+	Shader* get(const string& vertexPath, const string& fragmentPath, const ShaderDefines& defines = ShaderDefines());
+
+	/*
+	Source of "path" with includes resolved and "defines" added after #version. "files"
+	receives every file read, the first is "path". False with "error" set if one can't be read.
+	*/
+	bool preprocess(const string& path, const ShaderDefines& defines, string& source,
+		std::vector<string>& files, string& error);
+
+	// Worker for reloads, NULL to build them on the calling thread. Set it before the first
+	// reload, it must outlive the library's shaders.
+	void setCompiler(ShaderCompiler* compiler) { this->compiler = compiler; }
+	ShaderCompiler* getCompiler() const { return compiler; }
+
+	// Unmap every source and rebuild all variants from the files on disk. Each variant
+	// keeps its last good program until update() swaps in the new one.
+	void reload();
+	// Call once per frame. Returns true when any variant swapped in a new program.
+	bool update();
+	// True while any variant is still compiling
+	bool isCompiling() const;
+	// Destroy every variant and unmap the sources, once the compiler is done with them. Call
+	// while the context is current, before the compiler stops.
+	void release();
+
+	// Every file a variant was built from, includes too
+	std::vector<string> getFiles() const;
+
+	size_t getVariantCount() const { return variants.size(); }
+	// Calls to get() answered from the table, and variants built
+	unsigned int getHits() const { return hits; }
+	unsigned int getMisses() const { return misses; }
+
+private:
+	struct SourceFile
+	{
+		MappedFile file;
+		// FNV-1a of the contents
+		unsigned long long hash;
+	};
+
+	struct Variant
+	{
+		string vertexPath;
+		string fragmentPath;
+		ShaderDefines defines;
+		std::unique_ptr<Shader> shader;
+	};
+
+	const SourceFile* map(const string& path);
+	bool expand(const string& path, string& source, std::vector<string>& files, string& error);
+	string variantKey(const string& vertexPath, const string& fragmentPath, const ShaderDefines& defines);
+
+	void rebuildTable();
+
+	// Guards "sources", reloads map them on the compiler's thread
+	std::mutex sourceMutex;
+	std::unordered_map<string, std::unique_ptr<SourceFile>> sources;
+	std::vector<std::unique_ptr<Variant>> variants;
+	std::unordered_map<string, Variant*> variantTable;
+	// Set by reload(), the keys follow the file contents and are made again on the next get()
+	bool tableStale;
+	ShaderCompiler* compiler;
+	unsigned int hits;
+	unsigned int misses;
+};
+
+#endif // !SHADERLIBRARY_H
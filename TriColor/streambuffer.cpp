@@ -0,0 +1,157 @@
+#include "streambuffer.h"
+#include "glextensions.h"
+
+#include <chrono>
+
+typedef std::chrono::high_resolution_clock Clock;
+
+StreamBuffer::StreamBuffer(GLenum target, size_t slotSize)
+{
+	this->ID = 0;
+	this->target = target;
+	this->slotSize = slotSize;
+	this->mapped = NULL;
+	this->stats = {};
+
+	create();
+}
+
+StreamBuffer::~StreamBuffer()
+{
+	release();
+}
+
+void StreamBuffer::create()
+{
+	this->slot = 0;
+	this->head = 0;
+	for (int i = 0; i < STREAM_BUFFER_FRAMES; i++)
+		fences[i] = NULL;
+
+	GLsizeiptr size = (GLsizeiptr)(slotSize * STREAM_BUFFER_FRAMES);
+
+	glGenBuffers(1, &ID);
+	glBindBuffer(target, ID);
+
+	if (GLExt.bufferStorage)
+	{
+		// Map once and keep it mapped, coherent so no explicit flushes are needed
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		GLExt.BufferStorage(target, size, NULL, flags);
+		mapped = (char*)glMapBufferRange(target, 0, size, flags);
+	}
+	else
+	{
+		glBufferData(target, size, NULL, GL_STREAM_DRAW);
+	}
+
+	stats.persistent = mapped != NULL;
+	glBindBuffer(target, 0);
+}
+
+void StreamBuffer::release()
+{
+	for (int i = 0; i < STREAM_BUFFER_FRAMES; i++)
+	{
+		if (fences[i] != NULL)
+			glDeleteSync(fences[i]);
+		fences[i] = NULL;
+	}
+
+	if (ID != 0)
+	{
+		// Buffers mapped by either path are unmapped implicitly on delete
+		glDeleteBuffers(1, &ID);
+		ID = 0;
+	}
+
+	mapped = NULL;
+}
+
+void StreamBuffer::resize(size_t slotSize)
+{
+	if (this->slotSize == slotSize)
+		return;
+
+	release();
+	this->slotSize = slotSize;
+	create();
+}
+
+void StreamBuffer::beginFrame()
+{
+	slot = (slot + 1) % STREAM_BUFFER_FRAMES;
+	head = 0;
+	stats.fenceWaitMs = 0.0;
+
+	GLsync fence = fences[slot];
+	if (fence == NULL)
+		return;
+
+	// Most of the time the GPU is done with a slot from STREAM_BUFFER_FRAMES frames ago
+	GLenum result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+	if (result == GL_TIMEOUT_EXPIRED)
+	{
+		Clock::time_point start = Clock::now();
+
+		do
+		{
+			result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+		} while (result == GL_TIMEOUT_EXPIRED);
+
+		stats.fenceWaitMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+		stats.fenceWaitTotalMs += stats.fenceWaitMs;
+		stats.fenceStalls++;
+	}
+
+	glDeleteSync(fence);
+	fences[slot] = NULL;
+}
+
+void* StreamBuffer::allocate(size_t size, size_t alignment, GLintptr& offset)
+{
+	if (alignment > 1)
+		head = (head + alignment - 1) / alignment * alignment;
+
+	if (head + size > slotSize)
+		return NULL;
+
+	size_t slotOffset = (size_t)slot * slotSize;
+
+	// Without buffer storage, map the current slot on its first allocation of the frame
+	if (!stats.persistent && mapped == NULL)
+	{
+		glBindBuffer(target, ID);
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT;
+		mapped = (char*)glMapBufferRange(target, (GLintptr)slotOffset, (GLsizeiptr)slotSize, flags);
+		if (mapped == NULL)
+			return NULL;
+
+		// Keep the rest of the code indexing from the start of the buffer
+		mapped -= slotOffset;
+	}
+
+	offset = (GLintptr)(slotOffset + head);
+	head += size;
+	stats.bytesTotal += size;
+
+	return mapped + offset;
+}
+
+void StreamBuffer::flush()
+{
+	if (stats.persistent || mapped == NULL)
+		return;
+
+	glBindBuffer(target, ID);
+	glUnmapBuffer(target);
+	mapped = NULL;
+}
+
+void StreamBuffer::endFrame()
+{
+	flush();
+
+	fences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	stats.bytesLastFrame = head;
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#ifndef STREAMBUFFER_H
+#define STREAMBUFFER_H
+#include <glad/glad.h>
+
+#include <cstddef>
+
+#define STREAM_BUFFER_FRAMES 3
+
+struct StreamBufferStats
+{
+	// Bytes written during the last finished frame
+	size_t bytesLastFrame;
+	// Bytes written since the buffer was created
+	unsigned long long bytesTotal;
+	// Time spent waiting for the GPU to release a slot, last frame and in total
+	double fenceWaitMs;
+	double fenceWaitTotalMs;
+	// Number of frames where the slot was still in use and we had to wait
+	unsigned int fenceStalls;
+	// True when the buffer is persistently mapped, false on the glMapBufferRange fallback
+	bool persistent;
+};
+
+/*
+A ring of STREAM_BUFFER_FRAMES slots inside one buffer object for per-frame dynamic data.
+Every frame writes into its own slot, and a fence per slot makes sure the GPU is done
+reading a slot before the CPU writes into it again, so the buffer is never re-specified.
+
+With GL 4.4 (or ARB_buffer_storage) the whole buffer stays mapped for its lifetime,
+otherwise the current slot is mapped unsynchronized and unmapped again by flush().
+
+Per frame:
+	beginFrame();
+	void* data = allocate(size, alignment, offset);	// write into data, draw from offset
+	flush();										// before the draw calls
+	endFrame();										// after the last draw call reading the slot
+*/
+class StreamBuffer
+{
+public:
+	unsigned int ID;
+
+	StreamBuffer(GLenum target, size_t slotSize);
+	~StreamBuffer();
+
+	StreamBuffer(const StreamBuffer&) = delete;
+	StreamBuffer& operator=(const StreamBuffer&) = delete;
+
+	// Wait for the next slot to be released by the GPU and start writing into it.
+	void beginFrame();
+	// Reserve size bytes in the current slot. Returns NULL if the slot is full, otherwise
+	// "offset" receives the position of the data inside the buffer object.
+	void* allocate(size_t size, size_t alignment, GLintptr& offset);
+	// Make this frame's writes visible to GL. Must be called before drawing from the buffer.
+	void flush();
+	// Fence the current slot. Call after the last draw call that reads from it.
+	void endFrame();
+
+	// Recreate the buffer with a new slot size, previous contents are lost.
+	void resize(size_t slotSize);
+	// Delete the GL objects. Done by the destructor too, call it first if the context goes away earlier.
+	void release();
+
+	size_t getSlotSize() const { return slotSize; }
+	const StreamBufferStats& getStats() const { return stats; }
+
+private:
+	GLenum target;
+	size_t slotSize;
+	int slot;
+	size_t head;
+	char* mapped;
+	GLsync fences[STREAM_BUFFER_FRAMES];
+	StreamBufferStats stats;
+
+	void create();
+};
+
+#endif // !STREAMBUFFER_H
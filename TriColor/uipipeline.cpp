@@ -0,0 +1,296 @@
+#include "uipipeline.h"
+
+#include <chrono>
+#include <cstring>
+
+#include "imgui_impl_glfw.h"
+
+typedef std::chrono::high_resolution_clock Clock;
+
+// Copy a buffer, growing the destination only when it's too small
+template<typename T>
+static void copyBuffer(ImVector<T>& destination, const ImVector<T>& source)
+{
+	destination.resize(source.Size);
+	if (source.Size > 0)
+		memcpy(destination.Data, source.Data, source.size_in_bytes());
+}
+
+UiDrawSnapshot::UiDrawSnapshot()
+{
+}
+
+UiDrawSnapshot::~UiDrawSnapshot()
+{
+	for (int i = 0; i < lists.Size; i++)
+		IM_DELETE(lists[i]);
+}
+
+void UiDrawSnapshot::capture(const ImDrawData* source)
+{
+	// The lists are only containers here, they never draw and need no shared data
+	while (lists.Size < source->CmdListsCount)
+		lists.push_back(IM_NEW(ImDrawList)(NULL));
+
+	drawData.Valid = source->Valid;
+	drawData.CmdListsCount = source->CmdListsCount;
+	drawData.TotalIdxCount = source->TotalIdxCount;
+	drawData.TotalVtxCount = source->TotalVtxCount;
+	drawData.DisplayPos = source->DisplayPos;
+	drawData.DisplaySize = source->DisplaySize;
+	drawData.FramebufferScale = source->FramebufferScale;
+	drawData.OwnerViewport = NULL;
+	drawData.CmdLists.resize(source->CmdListsCount);
+
+	for (int i = 0; i < source->CmdListsCount; i++)
+	{
+		const ImDrawList* from = source->CmdLists[i];
+		ImDrawList* to = lists[i];
+
+		copyBuffer(to->CmdBuffer, from->CmdBuffer);
+		copyBuffer(to->IdxBuffer, from->IdxBuffer);
+		copyBuffer(to->VtxBuffer, from->VtxBuffer);
+		to->Flags = from->Flags;
+
+		drawData.CmdLists[i] = to;
+	}
+}
+
+ImDrawData* UiDrawSnapshot::getDrawData()
+{
+	return &drawData;
+}
+
+UiInputQueue::UiInputQueue()
+{
+	window = NULL;
+}
+
+void UiInputQueue::install(GLFWwindow* window)
+{
+	this->window = window;
+	glfwSetWindowUserPointer(window, this);
+
+	glfwSetWindowFocusCallback(window, focusCallback);
+	glfwSetCursorEnterCallback(window, cursorEnterCallback);
+	glfwSetCursorPosCallback(window, cursorPosCallback);
+	glfwSetMouseButtonCallback(window, mouseButtonCallback);
+	glfwSetScrollCallback(window, scrollCallback);
+	glfwSetKeyCallback(window, keyCallback);
+	glfwSetCharCallback(window, charCallback);
+}
+
+void UiInputQueue::replay()
+{
+	for (const UiInputEvent& event : events)
+	{
+		switch (event.type)
+		{
+		case UI_INPUT_FOCUS:
+			ImGui_ImplGlfw_WindowFocusCallback(window, event.args[0]);
+			break;
+		case UI_INPUT_CURSOR_ENTER:
+			ImGui_ImplGlfw_CursorEnterCallback(window, event.args[0]);
+			break;
+		case UI_INPUT_CURSOR_POS:
+			ImGui_ImplGlfw_CursorPosCallback(window, event.x, event.y);
+			break;
+		case UI_INPUT_MOUSE_BUTTON:
+			ImGui_ImplGlfw_MouseButtonCallback(window, event.args[0], event.args[1], event.args[2]);
+			break;
+		case UI_INPUT_SCROLL:
+			ImGui_ImplGlfw_ScrollCallback(window, event.x, event.y);
+			break;
+		case UI_INPUT_KEY:
+			ImGui_ImplGlfw_KeyCallback(window, event.args[0], event.args[1], event.args[2], event.args[3]);
+			break;
+		case UI_INPUT_CHAR:
+			ImGui_ImplGlfw_CharCallback(window, (unsigned int)event.args[0]);
+			break;
+		}
+	}
+
+	events.clear();
+}
+
+bool UiInputQueue::pending() const
+{
+	return !events.empty();
+}
+
+void UiInputQueue::push(GLFWwindow* window, const UiInputEvent& event)
+{
+	UiInputQueue* queue = (UiInputQueue*)glfwGetWindowUserPointer(window);
+	queue->events.push_back(event);
+}
+
+void UiInputQueue::focusCallback(GLFWwindow* window, int focused)
+{
+	push(window, { UI_INPUT_FOCUS, { focused }, 0.0, 0.0 });
+}
+
+void UiInputQueue::cursorEnterCallback(GLFWwindow* window, int entered)
+{
+	push(window, { UI_INPUT_CURSOR_ENTER, { entered }, 0.0, 0.0 });
+}
+
+void UiInputQueue::cursorPosCallback(GLFWwindow* window, double x, double y)
+{
+	push(window, { UI_INPUT_CURSOR_POS, {}, x, y });
+}
+
+void UiInputQueue::mouseButtonCallback(GLFWwindow* window, int button, int action, int mods)
+{
+	push(window, { UI_INPUT_MOUSE_BUTTON, { button, action, mods }, 0.0, 0.0 });
+}
+
+void UiInputQueue::scrollCallback(GLFWwindow* window, double x, double y)
+{
+	push(window, { UI_INPUT_SCROLL, {}, x, y });
+}
+
+void UiInputQueue::keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods)
+{
+	push(window, { UI_INPUT_KEY, { key, scancode, action, mods }, 0.0, 0.0 });
+}
+
+void UiInputQueue::charCallback(GLFWwindow* window, unsigned int c)
+{
+	push(window, { UI_INPUT_CHAR, { (int)c }, 0.0, 0.0 });
+}
+
+UiPipeline::UiPipeline(std::function<void()> build)
+	: build(build)
+{
+	threaded = false;
+	stopping = false;
+	building = false;
+	inFlight = false;
+	front = 0;
+	hasFront = false;
+	buildMs = 0.0;
+	waitMs = 0.0;
+}
+
+UiPipeline::~UiPipeline()
+{
+	setThreaded(false);
+}
+
+void UiPipeline::setThreaded(bool threaded)
+{
+	if (threaded == this->threaded)
+		return;
+
+	if (threaded)
+	{
+		stopping = false;
+		hasFront = false;
+		worker = std::thread(&UiPipeline::workerLoop, this);
+	}
+	else
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		wake.notify_one();
+		worker.join();
+		inFlight = false;
+	}
+
+	this->threaded = threaded;
+}
+
+bool UiPipeline::isThreaded() const
+{
+	return threaded;
+}
+
+void UiPipeline::buildFrame(UiDrawSnapshot* snapshot)
+{
+	Clock::time_point start = Clock::now();
+
+	build();
+	if (snapshot != NULL)
+		snapshot->capture(ImGui::GetDrawData());
+
+	buildMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+void UiPipeline::kick()
+{
+	if (!threaded)
+	{
+		buildFrame(NULL);
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		building = true;
+	}
+	inFlight = true;
+	wake.notify_one();
+}
+
+void UiPipeline::wait()
+{
+	waitMs = 0.0;
+	if (!threaded || !inFlight)
+		return;
+
+	Clock::time_point start = Clock::now();
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		done.wait(lock, [this]() { return !building; });
+	}
+	inFlight = false;
+	waitMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+	// The frame just built is the one to draw next
+	front = 1 - front;
+	hasFront = true;
+}
+
+ImDrawData* UiPipeline::getDrawData()
+{
+	if (!threaded)
+		return ImGui::GetDrawData();
+
+	return hasFront ? snapshots[front].getDrawData() : NULL;
+}
+
+double UiPipeline::getBuildMs() const
+{
+	return buildMs;
+}
+
+double UiPipeline::getWaitMs() const
+{
+	return waitMs;
+}
+
+void UiPipeline::workerLoop()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+
+	while (true)
+	{
+		wake.wait(lock, [this]() { return building || stopping; });
+
+		// Finish a frame that was asked for before stopping, the caller expects it built
+		if (building)
+		{
+			lock.unlock();
+			buildFrame(&snapshots[1 - front]);
+			lock.lock();
+
+			building = false;
+			done.notify_one();
+		}
+
+		if (stopping)
+			break;
+	}
+}
@@ -0,0 +1,145 @@
+#pragma once
+
+#ifndef UIPIPELINE_H
+#define UIPIPELINE_H
+#include <GLFW/glfw3.h>
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "imgui.h"
+
+/*
+Deep copy of an ImDrawData, owns its draw lists. Keeps the lists and their buffers between
+captures, so once the UI has settled a capture only copies without allocating.
+*/
+class UiDrawSnapshot
+{
+public:
+	UiDrawSnapshot();
+	~UiDrawSnapshot();
+
+	UiDrawSnapshot(const UiDrawSnapshot&) = delete;
+	UiDrawSnapshot& operator=(const UiDrawSnapshot&) = delete;
+
+	void capture(const ImDrawData* source);
+	ImDrawData* getDrawData();
+
+private:
+	ImDrawData drawData;
+	// Pool of lists, only the first drawData.CmdListsCount are in use
+	ImVector<ImDrawList*> lists;
+};
+
+enum UiInputType
+{
+	UI_INPUT_FOCUS,
+	UI_INPUT_CURSOR_ENTER,
+	UI_INPUT_CURSOR_POS,
+	UI_INPUT_MOUSE_BUTTON,
+	UI_INPUT_SCROLL,
+	UI_INPUT_KEY,
+	UI_INPUT_CHAR
+};
+
+struct UiInputEvent
+{
+	UiInputType type;
+	// Callback arguments in order, ints and doubles apart
+	int args[4];
+	double x, y;
+};
+
+/*
+Holds the window's input events until the UI is free to take them. The GLFW callbacks queue
+them instead of writing into the ImGui context, which may be in the middle of a frame on
+the UI thread, and replay() hands them to the ImGui GLFW backend in their original order.
+
+Everything happens on the main thread, GLFW only calls back from glfwPollEvents.
+*/
+class UiInputQueue
+{
+public:
+	UiInputQueue();
+
+	// Take over the window's input callbacks, use in place of the backend's install_callbacks
+	void install(GLFWwindow* window);
+	// Only while no UI frame is being built
+	void replay();
+	bool pending() const;
+
+private:
+	static void focusCallback(GLFWwindow* window, int focused);
+	static void cursorEnterCallback(GLFWwindow* window, int entered);
+	static void cursorPosCallback(GLFWwindow* window, double x, double y);
+	static void mouseButtonCallback(GLFWwindow* window, int button, int action, int mods);
+	static void scrollCallback(GLFWwindow* window, double x, double y);
+	static void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods);
+	static void charCallback(GLFWwindow* window, unsigned int c);
+	static void push(GLFWwindow* window, const UiInputEvent& event);
+
+	GLFWwindow* window;
+	std::vector<UiInputEvent> events;
+};
+
+/*
+Builds UI frames, ImGui::NewFrame() through ImGui::Render(), with a given function.
+
+Serial, kick() builds right away and getDrawData() is ImGui's own. Threaded, kick() hands
+the build to a worker thread and returns, so the next UI frame is built while the caller
+draws the previous one, taken from a snapshot. Between kick() and wait() the caller must
+leave the ImGui context alone, that includes feeding it input and the backends' NewFrame.
+*/
+class UiPipeline
+{
+public:
+	UiPipeline(std::function<void()> build);
+	~UiPipeline();
+
+	UiPipeline(const UiPipeline&) = delete;
+	UiPipeline& operator=(const UiPipeline&) = delete;
+
+	// Start or stop the worker, waits for a frame still being built
+	void setThreaded(bool threaded);
+	bool isThreaded() const;
+
+	void kick();
+	// Wait until the frame from kick() is built, returns right away when serial
+	void wait();
+
+	// UI to draw this frame, NULL until the first threaded frame is done
+	ImDrawData* getDrawData();
+
+	// Milliseconds the last build took, and the caller spent in wait()
+	double getBuildMs() const;
+	double getWaitMs() const;
+
+private:
+	void buildFrame(UiDrawSnapshot* snapshot);
+	void workerLoop();
+
+	std::function<void()> build;
+
+	std::thread worker;
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable done;
+	bool threaded;
+	bool stopping;
+	bool building;
+	// Kicked and not waited for yet, only the caller touches it
+	bool inFlight;
+
+	// Written by the worker, drawn from by the caller, swapped in wait()
+	UiDrawSnapshot snapshots[2];
+	int front;
+	bool hasFront;
+
+	double buildMs;
+	double waitMs;
+};
+
+#endif // !UIPIPELINE_H